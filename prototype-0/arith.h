@@ -0,0 +1,31 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <stdint.h>
+
+// integer arithmetic of the language: 64-bit two's complement, wrapping the way
+// daddu/dsubu/dmult/ddiv do on the MIPS64 target, so every engine prints the same numbers
+static inline long long arith_add(long long a, long long b) { return (long long)((uint64_t)a + (uint64_t)b); }
+static inline long long arith_sub(long long a, long long b) { return (long long)((uint64_t)a - (uint64_t)b); }
+static inline long long arith_mul(long long a, long long b) { return (long long)((uint64_t)a * (uint64_t)b); }
+
+// x / 0 is 0; INT64_MIN / -1 wraps to INT64_MIN instead of trapping
+static inline long long arith_div(long long a, long long b) {
+    if(b == 0)
+        return 0;
+    if(b == -1)
+        return arith_sub(0, a);
+    return a / b;
+}
+
+// value of a decimal literal, taken modulo 2^64 like the arithmetic above; strtoull would
+// saturate at ULLONG_MAX instead
+static inline long long arith_decimal(const char *digits) {
+    uint64_t value = 0;
+    for(; *digits >= '0' && *digits <= '9'; digits++) {
+        value = value * 10 + (uint64_t)(*digits - '0');
+    }
+    return (long long)value;
+}
+
+#endif
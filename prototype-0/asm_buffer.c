@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asm_buffer.h"
+
+void AsmBufferInit(AsmBuffer *buf, FILE *sink) {
+    buf->capacity = ASM_BUFFER_CHUNK;
+    buf->data = malloc(buf->capacity);
+    buf->length = 0;
+    buf->sink = sink;
+    buf->flushed = 0;
+}
+
+void AsmBufferFlush(AsmBuffer *buf) {
+    if(buf->sink && buf->length > 0) {
+        fwrite(buf->data, 1, buf->length, buf->sink);
+        buf->flushed += buf->length;
+        buf->length = 0;
+    }
+}
+
+void AsmBufferFree(AsmBuffer *buf) {
+    AsmBufferFlush(buf);
+    free(buf->data);
+    buf->data = NULL;
+    buf->length = buf->capacity = 0;
+}
+
+char *AsmBufferDetach(AsmBuffer *buf, size_t *length) {
+    char *end = AsmReserve(buf, 1);
+    *end = '\0';
+    char *text = buf->data;
+    if(length)
+        *length = buf->length;
+    AsmBufferInit(buf, buf->sink);
+    return text;
+}
+
+char *AsmReserve(AsmBuffer *buf, size_t n) {
+    if(buf->length + n > buf->capacity) {
+        // a full chunk goes to the sink; in memory (or for huge items) the buffer grows
+        if(buf->sink)
+            AsmBufferFlush(buf);
+        while(buf->length + n > buf->capacity)
+            buf->capacity *= 2;
+        buf->data = realloc(buf->data, buf->capacity);
+    }
+    return buf->data + buf->length;
+}
+
+void AsmCommit(AsmBuffer *buf, char *end) {
+    buf->length = end - buf->data;
+}
+
+void AsmPutString(AsmBuffer *buf, const char *text) {
+    size_t n = strlen(text);
+    char *p = AsmReserve(buf, n);
+    memcpy(p, text, n);
+    AsmCommit(buf, p + n);
+}
+
+// "00" "01" ... "99": two digits per division
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char *FormatInt(char *p, long long value) {
+    unsigned long long v = value;
+    if(value < 0) {
+        *p++ = '-';
+        v = 0 - v;
+    }
+
+    char digits[20];
+    char *d = digits + sizeof(digits);
+    while(v >= 100) {
+        unsigned pair = (v % 100) * 2;
+        v /= 100;
+        *--d = digit_pairs[pair + 1];
+        *--d = digit_pairs[pair];
+    }
+    if(v >= 10) {
+        *--d = digit_pairs[v * 2 + 1];
+        *--d = digit_pairs[v * 2];
+    } else {
+        *--d = '0' + v;
+    }
+
+    size_t n = digits + sizeof(digits) - d;
+    memcpy(p, d, n);
+    return p + n;
+}
+
+static const char register_names[32][4] = {
+    "r0",  "r1",  "r2",  "r3",  "r4",  "r5",  "r6",  "r7",
+    "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+    "r16", "r17", "r18", "r19", "r20", "r21", "r22", "r23",
+    "r24", "r25", "r26", "r27", "r28", "r29", "r30", "r31"
+};
+
+char *FormatRegister(char *p, int reg) {
+    const char *name = register_names[reg & 31];
+    p[0] = name[0];
+    p[1] = name[1];
+    if(reg < 10)
+        return p + 2;
+    p[2] = name[2];
+    return p + 3;
+}
+
+char *FormatString(char *p, const char *text) {
+    size_t n = strlen(text);
+    memcpy(p, text, n);
+    return p + n;
+}
@@ -0,0 +1,37 @@
+#ifndef ASM_BUFFER_H
+#define ASM_BUFFER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// assembly text is collected here and written to the sink in large chunks
+// instead of one fprintf per instruction
+#define ASM_BUFFER_CHUNK (64 * 1024)
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    FILE *sink; // NULL keeps everything in memory (see AsmBufferDetach)
+    size_t flushed; // bytes already written to the sink
+} AsmBuffer;
+
+void AsmBufferInit(AsmBuffer *buf, FILE *sink);
+void AsmBufferFlush(AsmBuffer *buf);
+// flushes, then releases the memory
+void AsmBufferFree(AsmBuffer *buf);
+// hand the text over as a NUL-terminated string (caller frees); the buffer is left empty
+char *AsmBufferDetach(AsmBuffer *buf, size_t *length);
+
+// pointer to room for n more bytes; write into it, then AsmCommit the new end
+char *AsmReserve(AsmBuffer *buf, size_t n);
+void AsmCommit(AsmBuffer *buf, char *end);
+
+void AsmPutString(AsmBuffer *buf, const char *text);
+
+// formatters for AsmReserve'd space; each returns the end of what it wrote
+char *FormatInt(char *p, long long value);       // at most 21 bytes
+char *FormatRegister(char *p, int reg);          // "r0".."r31", at most 3 bytes
+char *FormatString(char *p, const char *text);   // copy without the NUL
+
+#endif
@@ -0,0 +1,712 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "assembler.h"
+#include "machine_code.h"
+#include "asm_buffer.h"
+
+// each line is scanned once per pass: the mnemonic is looked up in a perfect hash
+// table and the operands are parsed by the routine for that instruction's format
+
+typedef enum {
+    FMT_RRR,      // daddu rd, rs, rt
+    FMT_RR,       // dmult rs, rt
+    FMT_R,        // mflo rd
+    FMT_RRI,      // daddiu rt, rs, #imm | label
+    FMT_RI,       // lui rt, #imm
+    FMT_SHIFT,    // dsll rd, rt, #sa
+    FMT_MEM,      // ld rt, label(rs) | offset(rs)
+    FMT_BRANCH,   // beq rs, rt, label
+    FMT_JUMP,     // j label
+    FMT_SYSCALL   // syscall [code]
+} OperandFormat;
+
+typedef struct {
+    const char *name;
+    int length;
+    OperandFormat format;
+    uint8_t opcode; // I/J-type opcode
+    uint8_t funct;  // R-type function code
+} Mnemonic;
+
+static const Mnemonic mnemonics[] = {
+    { "daddiu",  6, FMT_RRI,     OP_DADDIU, 0 },
+    { "daddu",   5, FMT_RRR,     0, FUNCT_DADDU },
+    { "dsubu",   5, FMT_RRR,     0, FUNCT_DSUBU },
+    { "sltu",    4, FMT_RRR,     0, FUNCT_SLTU },
+    { "dmult",   5, FMT_RR,      0, FUNCT_DMULT + 4 },
+    { "ddiv",    4, FMT_RR,      0, FUNCT_DDIV + 4 },
+    { "mflo",    4, FMT_R,       0, FUNCT_MFLO },
+    { "mfhi",    4, FMT_R,       0, FUNCT_MFHI },
+    { "ld",      2, FMT_MEM,     OP_LD, 0 },
+    { "sd",      2, FMT_MEM,     OP_SD, 0 },
+    { "beq",     3, FMT_BRANCH,  OP_BEQ, 0 },
+    { "bne",     3, FMT_BRANCH,  OP_BNE, 0 },
+    { "j",       1, FMT_JUMP,    OP_J, 0 },
+    { "syscall", 7, FMT_SYSCALL, 0, FUNCT_SYSCALL },
+    { "lui",     3, FMT_RI,      OP_LUI, 0 },
+    { "ori",     3, FMT_RRI,     OP_ORI, 0 },
+    { "dsll",    4, FMT_SHIFT,   0, FUNCT_DSLL },
+};
+
+// collision-free for the mnemonics above (and nop);
+// BuildMnemonicTable reports a collision if a new mnemonic breaks that
+#define MNEMONIC_HASH_SIZE 32
+#define MNEMONIC_HASH(s, n) (((n) + 2 * (s)[0] + 10 * ((n) > 1 ? (s)[1] : 0) + 12 * (s)[(n) - 1]) & (MNEMONIC_HASH_SIZE - 1))
+
+static const Mnemonic *mnemonic_table[MNEMONIC_HASH_SIZE];
+
+static void BuildMnemonicTable(void) {
+    if(mnemonic_table[MNEMONIC_HASH(mnemonics[0].name, mnemonics[0].length)])
+        return;
+    for(size_t i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); i++) {
+        const Mnemonic *m = &mnemonics[i];
+        int h = MNEMONIC_HASH(m->name, m->length);
+        if(mnemonic_table[h])
+            fprintf(stderr, "Internal error: mnemonics %s and %s collide\n", m->name, mnemonic_table[h]->name);
+        else
+            mnemonic_table[h] = m;
+    }
+}
+
+static const Mnemonic *LookupMnemonic(const char *s, int n) {
+    if(n < 1)
+        return NULL;
+    const Mnemonic *m = mnemonic_table[MNEMONIC_HASH(s, n)];
+    if(m && m->length == n && memcmp(m->name, s, n) == 0)
+        return m;
+    return NULL;
+}
+
+// LABEL TABLE
+
+typedef enum {
+    SECTION_DATA,
+    SECTION_CODE
+} Section;
+
+typedef struct {
+    const char *name;   // points into the source text
+    int length;
+    Section section;
+    uint64_t address;
+    uint64_t size;      // bytes of the data item (0 for code labels)
+    int line;           // where it is defined
+    int *refs;          // lines that use it
+    int ref_count;
+    int ref_capacity;
+} Label;
+
+// open addressing over indices into items (+1, 0 = empty)
+typedef struct {
+    Label *items;
+    int count;
+    int capacity;
+    int *slots;
+    int slot_count; // power of two
+} LabelTable;
+
+static uint32_t HashName(const char *name, int length) {
+    uint32_t h = 2166136261u;
+    for(int i = 0; i < length; i++)
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    return h;
+}
+
+static int *FindSlot(LabelTable *t, const char *name, int length) {
+    uint32_t mask = t->slot_count - 1;
+    uint32_t i = HashName(name, length) & mask;
+    while(t->slots[i]) {
+        Label *l = &t->items[t->slots[i] - 1];
+        if(l->length == length && memcmp(l->name, name, length) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return &t->slots[i];
+}
+
+static Label *FindLabel(LabelTable *t, const char *name, int length) {
+    int *slot = FindSlot(t, name, length);
+    return *slot ? &t->items[*slot - 1] : NULL;
+}
+
+// new label, NULL if it already exists
+static Label *AddLabelEntry(LabelTable *t, const char *name, int length) {
+    if((t->count + 1) * 2 > t->slot_count) {
+        free(t->slots);
+        t->slot_count = t->slot_count ? t->slot_count * 2 : 256;
+        t->slots = calloc(t->slot_count, sizeof(int));
+        for(int i = 0; i < t->count; i++)
+            *FindSlot(t, t->items[i].name, t->items[i].length) = i + 1;
+    }
+    int *slot = FindSlot(t, name, length);
+    if(*slot)
+        return NULL;
+    if(t->count >= t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 64;
+        t->items = realloc(t->items, sizeof(Label) * t->capacity);
+    }
+    Label *l = &t->items[t->count];
+    memset(l, 0, sizeof(*l));
+    l->name = name;
+    l->length = length;
+    *slot = ++t->count;
+    return l;
+}
+
+static void AddReference(Label *l, int line) {
+    if(l->ref_count && l->refs[l->ref_count - 1] == line)
+        return;
+    if(l->ref_count >= l->ref_capacity) {
+        l->ref_capacity = l->ref_capacity ? l->ref_capacity * 2 : 4;
+        l->refs = realloc(l->refs, sizeof(int) * l->ref_capacity);
+    }
+    l->refs[l->ref_count++] = line;
+}
+
+static void FreeLabels(LabelTable *t) {
+    for(int i = 0; i < t->count; i++)
+        free(t->items[i].refs);
+    free(t->items);
+    free(t->slots);
+}
+
+// LINE SCANNING
+
+typedef struct {
+    const char *p;
+    const char *end;
+} Cursor;
+
+typedef struct {
+    LabelTable labels;
+    Section section;
+    uint64_t data_size;
+    uint64_t pc;            // code address of the current instruction
+    int line;
+    int errors;
+    int pending_first;      // data labels waiting for their item
+    int pass;
+    ObjectImage *image;
+} Assembler;
+
+static void Error(Assembler *as, const char *message, const char *detail, int detail_length) {
+    if(detail)
+        fprintf(stderr, "Error: line %d: %s %.*s\n", as->line, message, detail_length, detail);
+    else
+        fprintf(stderr, "Error: line %d: %s\n", as->line, message);
+    as->errors++;
+}
+
+static void SkipBlanks(Cursor *c) {
+    while(c->p < c->end && (*c->p == ' ' || *c->p == '\t'))
+        c->p++;
+}
+
+static int IsLabelChar(char ch) {
+    return isalnum((unsigned char)ch) || ch == '_' || ch == '.' || ch == '$';
+}
+
+// only blanks or a ; comment left
+static int AtLineEnd(Cursor *c) {
+    SkipBlanks(c);
+    return c->p >= c->end || *c->p == ';';
+}
+
+static int Expect(Cursor *c, char ch) {
+    SkipBlanks(c);
+    if(c->p < c->end && *c->p == ch) {
+        c->p++;
+        return 1;
+    }
+    return 0;
+}
+
+// r0..r31 (R and $ are accepted too)
+static int ParseRegister(Cursor *c, int *reg) {
+    SkipBlanks(c);
+    if(c->p >= c->end || (*c->p != 'r' && *c->p != 'R' && *c->p != '$'))
+        return 0;
+    const char *p = c->p + 1;
+    int value = 0, digits = 0;
+    while(p < c->end && isdigit((unsigned char)*p) && digits < 3) {
+        value = value * 10 + (*p++ - '0');
+        digits++;
+    }
+    if(digits == 0 || value > 31 || (p < c->end && IsLabelChar(*p)))
+        return 0;
+    c->p = p;
+    *reg = value;
+    return 1;
+}
+
+// [#][+-]digits, decimal or 0x hex
+static int ParseImmediate(Cursor *c, long long *value) {
+    SkipBlanks(c);
+    const char *p = c->p;
+    if(p < c->end && *p == '#')
+        p++;
+    int negative = 0;
+    if(p < c->end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    unsigned long long v = 0;
+    int digits = 0;
+    if(p + 1 < c->end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        while(p < c->end && isxdigit((unsigned char)*p)) {
+            v = v * 16 + (isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10));
+            p++;
+            digits++;
+        }
+    } else {
+        while(p < c->end && isdigit((unsigned char)*p)) {
+            v = v * 10 + (*p++ - '0');
+            digits++;
+        }
+    }
+    if(digits == 0)
+        return 0;
+    c->p = p;
+    *value = negative ? -(long long)v : (long long)v;
+    return 1;
+}
+
+// label name; *name points into the line, not NUL-terminated
+static int ParseLabel(Cursor *c, const char **name, int *length) {
+    SkipBlanks(c);
+    const char *p = c->p;
+    if(p >= c->end || isdigit((unsigned char)*p) || !IsLabelChar(*p))
+        return 0;
+    while(p < c->end && IsLabelChar(*p))
+        p++;
+    *name = c->p;
+    *length = p - c->p;
+    c->p = p;
+    return 1;
+}
+
+// address of a label used as an operand
+static int ResolveLabel(Assembler *as, const char *name, int length, Section *section, long long *address) {
+    Label *l = FindLabel(&as->labels, name, length);
+    if(!l) {
+        Error(as, "unknown label", name, length);
+        return 0;
+    }
+    AddReference(l, as->line);
+    if(section)
+        *section = l->section;
+    *address = (long long)l->address;
+    return 1;
+}
+
+// immediate or label operand
+static int ParseValue(Assembler *as, Cursor *c, long long *value) {
+    const char *name;
+    int length;
+    if(ParseImmediate(c, value))
+        return 1;
+    if(ParseLabel(c, &name, &length))
+        return ResolveLabel(as, name, length, NULL, value);
+    return 0;
+}
+
+// ori and lui take the 16 bits as they are, daddiu and ld/sd sign-extend them
+static int FitsImmediate(Assembler *as, const Mnemonic *m, long long value) {
+    if(m->opcode == OP_ORI || m->opcode == OP_LUI) {
+        if(value < 0 || value > 65535) {
+            Error(as, "immediate is not 0..65535", NULL, 0);
+            return 0;
+        }
+    } else if(value < -32768 || value > 32767) {
+        Error(as, "immediate is not -32768..32767", NULL, 0);
+        return 0;
+    }
+    return 1;
+}
+
+// operands of one instruction, per format
+static int ParseOperands(Assembler *as, Cursor *c, const Mnemonic *m, uint32_t *code) {
+    int rd, rs, rt;
+    long long imm = 0;
+    const char *name;
+    int length;
+
+    switch(m->format) {
+        case FMT_RRR:
+            if(!ParseRegister(c, &rd) || !Expect(c, ',') || !ParseRegister(c, &rs) ||
+               !Expect(c, ',') || !ParseRegister(c, &rt))
+                return 0;
+            *code = Encode_R_Type(rs, rt, rd, 0, m->funct);
+            return 1;
+        case FMT_RR:
+            if(!ParseRegister(c, &rs) || !Expect(c, ',') || !ParseRegister(c, &rt))
+                return 0;
+            *code = Encode_R_Type(rs, rt, 0, 0, m->funct);
+            return 1;
+        case FMT_R:
+            if(!ParseRegister(c, &rd))
+                return 0;
+            *code = Encode_R_Type(0, 0, rd, 0, m->funct);
+            return 1;
+        case FMT_RRI:
+            if(!ParseRegister(c, &rt) || !Expect(c, ',') || !ParseRegister(c, &rs) ||
+               !Expect(c, ',') || !ParseValue(as, c, &imm) || !FitsImmediate(as, m, imm))
+                return 0;
+            *code = Encode_I_Type(m->opcode, rs, rt, (int16_t)imm);
+            return 1;
+        case FMT_RI:
+            if(!ParseRegister(c, &rt) || !Expect(c, ',') || !ParseImmediate(c, &imm) || !FitsImmediate(as, m, imm))
+                return 0;
+            *code = Encode_I_Type(m->opcode, 0, rt, (int16_t)imm);
+            return 1;
+        case FMT_SHIFT:
+            if(!ParseRegister(c, &rd) || !Expect(c, ',') || !ParseRegister(c, &rt) ||
+               !Expect(c, ',') || !ParseImmediate(c, &imm))
+                return 0;
+            if(imm < 0 || imm > 31) {
+                Error(as, "shift amount is not 0..31", NULL, 0);
+                return 0;
+            }
+            *code = Encode_R_Type(0, rt, rd, imm, m->funct);
+            return 1;
+        case FMT_MEM:
+            if(!ParseRegister(c, &rt) || !Expect(c, ','))
+                return 0;
+            SkipBlanks(c);
+            if(c->p < c->end && *c->p != '(' && !ParseValue(as, c, &imm))
+                return 0;
+            if(!Expect(c, '(') || !ParseRegister(c, &rs) || !Expect(c, ')') || !FitsImmediate(as, m, imm))
+                return 0;
+            *code = Encode_I_Type(m->opcode, rs, rt, (int16_t)imm);
+            return 1;
+        case FMT_BRANCH: {
+            Section section;
+            if(!ParseRegister(c, &rs) || !Expect(c, ',') || !ParseRegister(c, &rt) ||
+               !Expect(c, ',') || !ParseLabel(c, &name, &length) ||
+               !ResolveLabel(as, name, length, &section, &imm))
+                return 0;
+            if(section != SECTION_CODE) {
+                Error(as, "branch to a data label", name, length);
+                return 0;
+            }
+            // offset in instructions from the one after the branch
+            long long offset = (imm - (long long)(as->pc + 4)) / 4;
+            if(offset < -32768 || offset > 32767) {
+                Error(as, "branch target out of range", name, length);
+                return 0;
+            }
+            *code = Encode_I_Type(m->opcode, rs, rt, (int16_t)offset);
+            return 1;
+        }
+        case FMT_JUMP: {
+            Section section;
+            if(!ParseLabel(c, &name, &length) || !ResolveLabel(as, name, length, &section, &imm))
+                return 0;
+            if(section != SECTION_CODE) {
+                Error(as, "jump to a data label", name, length);
+                return 0;
+            }
+            *code = Encode_J_Type(m->opcode, (uint32_t)(imm / 4));
+            return 1;
+        }
+        case FMT_SYSCALL:
+            if(!AtLineEnd(c) && !ParseImmediate(c, &imm))
+                return 0;
+            *code = Encode_R_Type(0, 0, 0, imm, m->funct);
+            return 1;
+    }
+    return 0;
+}
+
+// DIRECTIVES (pass 1 only; pass 2 skips them)
+
+// every data item starts on a new 64-bit word, as in EduMIPS64 memory
+static void AlignData(Assembler *as) {
+    as->data_size = (as->data_size + 7) & ~(uint64_t)7;
+}
+
+// labels defined since the last data item belong to the one starting now
+static void PlacePendingLabels(Assembler *as, uint64_t size) {
+    for(int i = as->pending_first; i < as->labels.count; i++) {
+        as->labels.items[i].address = as->data_size;
+        as->labels.items[i].size = size;
+    }
+    as->pending_first = as->labels.count;
+}
+
+// bytes of a "..." string including its NUL, escapes counted once
+static int StringSize(Cursor *c, uint64_t *size) {
+    if(!Expect(c, '"'))
+        return 0;
+    uint64_t n = 0;
+    while(c->p < c->end && *c->p != '"') {
+        if(*c->p == '\\' && c->p + 1 < c->end)
+            c->p++;
+        c->p++;
+        n++;
+    }
+    if(c->p >= c->end)
+        return 0;
+    c->p++;
+    *size = n + 1;
+    return 1;
+}
+
+// copy a "..." string with its escapes decoded; StringSize already checked it
+static void CopyString(Cursor c, uint8_t *dest) {
+    c.p++;
+    while(*c.p != '"') {
+        char ch = *c.p++;
+        if(ch == '\\') {
+            ch = *c.p++;
+            switch(ch) {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case '0': ch = '\0'; break;
+                default: break; // \" and \\ stand for themselves
+            }
+        }
+        *dest++ = ch;
+    }
+    *dest = '\0';
+}
+
+// .word values are 64-bit, big-endian like the code
+static void CopyWords(Cursor c, uint8_t *dest) {
+    long long value;
+    do {
+        ParseImmediate(&c, &value);
+        for(int shift = 56; shift >= 0; shift -= 8) {
+            *dest++ = (uint8_t)((uint64_t)value >> shift);
+        }
+    } while(Expect(&c, ','));
+}
+
+static void Directive(Assembler *as, Cursor *c) {
+    const char *name = c->p;
+    c->p++;
+    while(c->p < c->end && isalnum((unsigned char)*c->p))
+        c->p++;
+    int length = c->p - name;
+
+    if((length == 5 && memcmp(name, ".data", 5) == 0)) {
+        as->section = SECTION_DATA;
+        return;
+    }
+    if((length == 5 && (memcmp(name, ".code", 5) == 0 || memcmp(name, ".text", 5) == 0))) {
+        AlignData(as);
+        PlacePendingLabels(as, 0);
+        as->section = SECTION_CODE;
+        return;
+    }
+    if(as->section != SECTION_DATA) {
+        Error(as, "data directive outside .data:", name, length);
+        return;
+    }
+
+    uint64_t size = 0;
+    long long value;
+    Cursor operands = *c;
+    SkipBlanks(&operands);
+    if(length == 6 && memcmp(name, ".space", 6) == 0) {
+        if(!ParseImmediate(c, &value) || value < 0) {
+            Error(as, "bad size for", name, length);
+            return;
+        }
+        size = value;
+    } else if(length == 7 && memcmp(name, ".asciiz", 7) == 0) {
+        if(!StringSize(c, &size)) {
+            Error(as, "bad string for", name, length);
+            return;
+        }
+    } else if(length == 5 && memcmp(name, ".word", 5) == 0) {
+        do {
+            if(!ParseImmediate(c, &value)) {
+                Error(as, "bad value for", name, length);
+                return;
+            }
+            size += 8;
+        } while(Expect(c, ','));
+    } else {
+        Error(as, "unknown directive", name, length);
+        return;
+    }
+
+    AlignData(as);
+    PlacePendingLabels(as, size);
+    uint8_t *data = ObjectReserveData(as->image, as->data_size + size) + as->data_size;
+    if(name[1] == 'a')
+        CopyString(operands, data);
+    else if(name[1] == 'w')
+        CopyWords(operands, data);
+    as->data_size += size;
+    if(!AtLineEnd(c))
+        Error(as, "unexpected text after", name, length);
+}
+
+// one source line in either pass; adds the encoded instruction to the image in pass 2
+static void AssembleLine(Assembler *as, Cursor *c) {
+    // # comment lines
+    SkipBlanks(c);
+    if(c->p < c->end && *c->p == '#')
+        return;
+
+    // leading "name:" labels
+    for(;;) {
+        Cursor save = *c;
+        const char *name;
+        int length;
+        if(!ParseLabel(c, &name, &length) || !Expect(c, ':')) {
+            *c = save;
+            break;
+        }
+        if(as->pass == 2)
+            continue;
+        Label *l = AddLabelEntry(&as->labels, name, length);
+        if(!l) {
+            Error(as, "label defined twice:", name, length);
+            continue;
+        }
+        l->section = as->section;
+        l->line = as->line;
+        l->address = as->section == SECTION_CODE ? as->pc : as->data_size;
+        if(as->section == SECTION_CODE)
+            as->pending_first = as->labels.count;
+    }
+
+    if(AtLineEnd(c))
+        return;
+    if(*c->p == '.') {
+        if(as->pass == 1)
+            Directive(as, c);
+        return;
+    }
+
+    if(as->section != SECTION_CODE) {
+        if(as->pass == 1)
+            Error(as, "instruction outside .code", NULL, 0);
+        return;
+    }
+
+    const char *word = c->p;
+    while(c->p < c->end && isalpha((unsigned char)*c->p))
+        c->p++;
+    const Mnemonic *m = LookupMnemonic(word, c->p - word);
+    if(!m) {
+        if(as->pass == 1)
+            Error(as, "unknown instruction", word, c->p - word);
+        return;
+    }
+
+    if(as->pass == 2) {
+        uint32_t code;
+        int errors = as->errors;
+        if(ParseOperands(as, c, m, &code) && AtLineEnd(c))
+            ObjectAddWord(as->image, code, as->line);
+        else if(as->errors == errors)
+            Error(as, "bad operands for", m->name, m->length);
+    }
+    as->pc += 4;
+}
+
+// run one pass over every line of the source
+static void AssemblePass(Assembler *as, const char *text, size_t size) {
+    as->section = SECTION_CODE;
+    as->pc = 0;
+    as->line = 0;
+
+    const char *line = text;
+    const char *text_end = text + size;
+    while(line < text_end) {
+        const char *eol = memchr(line, '\n', text_end - line);
+        if(!eol)
+            eol = text_end;
+        as->line++;
+
+        Cursor c = { line, eol };
+        if(c.end > c.p && c.end[-1] == '\r')
+            c.end--;
+        AssembleLine(as, &c);
+        line = eol + 1;
+    }
+}
+
+static void PrintLabelLayout(const LabelTable *t, Section section, FILE *out) {
+    for(int i = 0; i < t->count; i++) {
+        const Label *l = &t->items[i];
+        if(l->section != section)
+            continue;
+        if(section == SECTION_DATA)
+            fprintf(out, ";   0x%04llX %6llu  %-16.*s %5d ",
+                    (unsigned long long)l->address, (unsigned long long)l->size, l->length, l->name, l->line);
+        else
+            fprintf(out, ";   0x%04llX         %-16.*s %5d ",
+                    (unsigned long long)l->address, l->length, l->name, l->line);
+        for(int r = 0; r < l->ref_count; r++)
+            fprintf(out, "%s%d", r ? ", " : " ", l->refs[r]);
+        fprintf(out, "\n");
+    }
+}
+
+// final layout and cross-reference
+static void PrintLayout(const Assembler *as, FILE *out) {
+    fprintf(out, "; data layout: %llu bytes\n", (unsigned long long)as->data_size);
+    fprintf(out, ";   address   size  label            line  referenced on\n");
+    PrintLabelLayout(&as->labels, SECTION_DATA, out);
+    fprintf(out, "; code layout: %llu bytes, %llu instructions\n",
+            (unsigned long long)as->pc, (unsigned long long)(as->pc / 4));
+    fprintf(out, ";   address         label            line  referenced on\n");
+    PrintLabelLayout(&as->labels, SECTION_CODE, out);
+}
+
+// whole file in memory, so lines can be any length
+static char *ReadWholeFile(FILE *in, size_t *size) {
+    size_t capacity = 1 << 16, length = 0, n;
+    char *data = malloc(capacity);
+    while((n = fread(data + length, 1, capacity - length, in)) > 0) {
+        length += n;
+        if(length == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    *size = length;
+    return data;
+}
+
+int AssembleFile(const char *asm_file, ObjectImage *image, FILE *layout) {
+    FILE *in = fopen(asm_file, "r");
+    if(!in)
+        return -1;
+
+    size_t size;
+    char *text = ReadWholeFile(in, &size);
+    fclose(in);
+
+    BuildMnemonicTable();
+    Assembler as;
+    memset(&as, 0, sizeof(as));
+    as.image = image;
+
+    // pass 1: addresses of every label, and the .data image
+    as.pass = 1;
+    AssemblePass(&as, text, size);
+    AlignData(&as);
+    PlacePendingLabels(&as, 0);
+    ObjectReserveData(image, as.data_size);
+
+    // pass 2: encode
+    as.pass = 2;
+    AssemblePass(&as, text, size);
+
+    if(layout)
+        PrintLayout(&as, layout);
+
+    int errors = as.errors;
+    FreeLabels(&as.labels);
+    free(text);
+    return errors;
+}
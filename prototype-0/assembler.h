@@ -0,0 +1,15 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stdio.h>
+#include "object_file.h"
+
+// standalone two-pass assembler for .s files (the compiler encodes its own code directly)
+// pass 1 lays out .data (.space, .asciiz, .word; every item 8-byte aligned) into image->data
+// and .code, collecting labels into a hash table; pass 2 encodes the instructions against it
+// into image->code
+// layout, when not NULL, receives the final data/code layout with a label cross-reference
+// returns the number of errors, -1 if the file cannot be opened
+int AssembleFile(const char *asm_file, ObjectImage *image, FILE *layout);
+
+#endif
@@ -5,6 +5,13 @@
 #include "assembly.h"
 #include "symbol_table.h"
 #include "ast.h"
+#include "instruction.h"
+#include "peephole.h"
+#include "scheduler.h"
+#include "machine_code.h"
+#include "ir.h"
+#include "ir_opt.h"
+#include "mips_emitter.h"
 
 // string table for storing string literals
 typedef struct {
@@ -12,54 +19,32 @@ typedef struct {
     char *value;
 } StringEntry;
 
-static StringEntry string_table[100];
+static StringEntry *string_table = NULL;
 static int string_count = 0;
+static int string_capacity = 0;
 static int string_label_counter = 0;
 
-// Track string variables separately
-typedef struct {
-    char *name;
-    char *value;  // For initialized strings
-    int is_initialized;
-} StringVariable;
-
-static StringVariable string_vars[100];
-static int string_var_count = 0;
-
 // track w/c vars have been initialized
-static char *initialized_vars[100];
+static char **initialized_vars = NULL;
 static int init_var_count = 0;
+static int init_var_capacity = 0;
 
-// r4 for syscall arguments
-// r10-r19 for temporary calculations
-static int temp_start = 10;
-static int temp_next = 10;
-static int temp_max = 19;
+// a new string table entry for text (owned), labelled strN
+static StringEntry *NewStringEntry(char *text) {
+    if(string_count >= string_capacity) {
+        string_capacity = string_capacity ? string_capacity * 2 : 64;
+        string_table = realloc(string_table, sizeof(StringEntry) * string_capacity);
+    }
+    StringEntry *entry = &string_table[string_count++];
+    entry->value = text;
+    entry->label = malloc(20);
+    sprintf(entry->label, "str%d", string_label_counter++);
+    return entry;
+}
 
-// get or create label for a string literal
+// get or create label for a string literal (text as the lexer left it, escapes already resolved)
 static char* GetStringLabel(const char *str, int is_variable_decl) {
-    // process escape sequences
-    char *processed_str = malloc(strlen(str) * 2 + 1);
-    char *dst = processed_str;
-    
-    for(const char *src = str; *src; src++) {
-        if(*src == '\\' && *(src+1)) {
-            src++;
-            switch(*src) {
-                case 'n': *dst++ = '\n'; break;
-                case 't': *dst++ = '\t'; break;
-                case '"': *dst++ = '"'; break;
-                case '\\': *dst++ = '\\'; break;
-                default:
-                    *dst++ = '\\';
-                    *dst++ = *src;
-                    break;
-            }
-        } else {
-            *dst++ = *src;
-        }
-    }
-    *dst = '\0';
+    char *processed_str = strdup(str);
     
     // For string variable declarations (ch x = "value")
     if(is_variable_decl) {
@@ -76,48 +61,27 @@ static char* GetStringLabel(const char *str, int is_variable_decl) {
     }
     
     // create new string entry
-    if(string_count >= 100) {
-        free(processed_str);
-        return NULL;
-    }
-    
-    string_table[string_count].value = processed_str;
-    char *label = malloc(20);
-    sprintf(label, "str%d", string_label_counter++);
-    string_table[string_count].label = label;
-    
-    string_count++;
-    return label;
+    return NewStringEntry(processed_str)->label;
 }
 
-// Add or update string variable
-static void AddStringVariable(const char *name, const char *value, int is_initialized) {
-    for(int i = 0; i < string_var_count; i++) {
-        if(strcmp(string_vars[i].name, name) == 0) {
-            // Update existing
-            free(string_vars[i].value);
-            string_vars[i].value = strdup(value);
-            string_vars[i].is_initialized = is_initialized;
-            return;
-        }
+// contents of a string literal label, for the print merger
+static const char *LiteralText(const char *label) {
+    for(int i = 0; i < string_count; i++) {
+        if(strcmp(string_table[i].label, label) == 0)
+            return string_table[i].value;
     }
-    
-    if(string_var_count >= 100) return;
-    
-    string_vars[string_var_count].name = strdup(name);
-    string_vars[string_var_count].value = strdup(value);
-    string_vars[string_var_count].is_initialized = is_initialized;
-    string_var_count++;
+    return NULL;
 }
 
-// Get string variable value
-static char* GetStringVariableValue(const char *name) {
-    for(int i = 0; i < string_var_count; i++) {
-        if(strcmp(string_vars[i].name, name) == 0) {
-            return string_vars[i].value;
-        }
+// label of the literal with this (already unescaped) text, added if needed
+static const char *LiteralLabel(const char *text) {
+    for(int i = 0; i < string_count; i++) {
+        if(strcmp(string_table[i].value, text) == 0)
+            return string_table[i].label;
     }
-    return NULL;
+    StringEntry *entry = NewStringEntry(strdup(text));
+    AddLabel(entry->label, strlen(text) + 1);
+    return entry->label;
 }
 
 // mark variable as initialized
@@ -126,34 +90,16 @@ static void mark_initialized(const char *name) {
         if(strcmp(initialized_vars[i], name) == 0)
             return;
     }
-    if(init_var_count < 100) {
-        initialized_vars[init_var_count++] = strdup(name);
+    if(init_var_count >= init_var_capacity) {
+        init_var_capacity = init_var_capacity ? init_var_capacity * 2 : 64;
+        initialized_vars = realloc(initialized_vars, sizeof(char *) * init_var_capacity);
     }
+    initialized_vars[init_var_count++] = strdup(name);
 }
 
 // initialize assembly generator
 void AssemblyInit() {
-    temp_next = temp_start;
     init_var_count = 0;
-    string_var_count = 0;
-}
-
-// allocate a temporary reg (r10-r19)
-static int NewTempRegister() {
-    int r = temp_next++;
-    if(temp_next > temp_max)
-        temp_next = temp_start;
-    return r;
-}
-
-// reset temporary reg allocation
-static void ResetTempRegister() {
-    temp_next = temp_start;
-}
-
-// load immediate value into register
-static void GenerateLoadImmediate(FILE *out, int reg, long long imm) {
-    fprintf(out, "daddiu r%d, r0, #%lld\n", reg, imm);
 }
 
 // collect symbols and strings from AST
@@ -175,11 +121,11 @@ static void CollectSymbolsFromAST(Node *node) {
                         // simple declaration: int x or ch x
                         // We'll determine type during code generation
                         // For now, allocate as integer (will be updated if string)
-                        AllocateRegisterForTheSymbol(item->str_val);
+                        AllocateVariable(item->str_val);
                     } else if(item->node_type == 3 && item->binop.op == '=') {
                         // initialized declaration: int x = expr
                         if(item->binop.left && item->binop.left->node_type == 2) {
-                            AllocateRegisterForTheSymbol(item->binop.left->str_val);
+                            AllocateVariable(item->binop.left->str_val);
                         }
                         CollectSymbolsFromAST(item->binop.right);
                     } else if(item->node_type == 8) {  // NODE_STR_ASSIGN - ch x = "string"
@@ -188,13 +134,11 @@ static void CollectSymbolsFromAST(Node *node) {
                         
                         if(id_node && id_node->node_type == 2 && 
                            str_node && str_node->node_type == 1) {
-                            // This is a string variable declaration: ch name = "value"
-                            // Allocate as string variable
+                            // string variable declaration: ch name = "value"
+                            // the variable holds the address of the literal
                             AllocateStringVariable(id_node->str_val);
                             mark_initialized(id_node->str_val);
-                            
-                            // Store the string value
-                            AddStringVariable(id_node->str_val, str_node->str_val, 1);
+                            GetStringLabel(str_node->str_val, 0);
                         }
                     }
                     item = item->next;
@@ -209,8 +153,8 @@ static void CollectSymbolsFromAST(Node *node) {
                         // integer assignment: x = expr
                         if(assign->binop.left && assign->binop.left->node_type == 2) {
                             // Make sure variable exists
-                            if(GetRegisterOfTheSymbol(assign->binop.left->str_val) == -1) {
-                                AllocateRegisterForTheSymbol(assign->binop.left->str_val);
+                            if(GetVariableOfTheSymbol(assign->binop.left->str_val) == -1) {
+                                AllocateVariable(assign->binop.left->str_val);
                             }
                         }
                         CollectSymbolsFromAST(assign->binop.right);
@@ -221,8 +165,9 @@ static void CollectSymbolsFromAST(Node *node) {
                         if(id_node && id_node->node_type == 2 && 
                            str_node && str_node->node_type == 1) {
                             // string assignment: name = "new value"
-                            // Update string variable
-                            AddStringVariable(id_node->str_val, str_node->str_val, 1);
+                            if(GetVariableOfTheSymbol(id_node->str_val) == -1)
+                                AllocateStringVariable(id_node->str_val);
+                            GetStringLabel(str_node->str_val, 0);
                         }
                     }
                     assign = assign->next;
@@ -257,10 +202,10 @@ static void CollectSymbolsFromAST(Node *node) {
                 
             case 2: // NODE_ID - variable reference
                 // Ensure variable exists
-                if(GetRegisterOfTheSymbol(current->str_val) == -1) {
+                if(GetVariableOfTheSymbol(current->str_val) == -1) {
                     // Check if it's a string variable by looking at context
                     // For now, allocate as integer
-                    AllocateRegisterForTheSymbol(current->str_val);
+                    AllocateVariable(current->str_val);
                 }
                 break;
                 
@@ -274,7 +219,7 @@ static void CollectSymbolsFromAST(Node *node) {
             case 8: // NODE_STR_ASSIGN
                 if(current->str_assign.id && current->str_assign.id->node_type == 2) {
                     // Make sure string variable exists
-                    if(GetRegisterOfTheSymbol(current->str_assign.id->str_val) == -1) {
+                    if(GetVariableOfTheSymbol(current->str_assign.id->str_val) == -1) {
                         AllocateStringVariable(current->str_assign.id->str_val);
                     }
                 }
@@ -288,90 +233,50 @@ static void CollectSymbolsFromAST(Node *node) {
     }
 }
 
-// generate code for an expression
-static int GenerateExpression(Node *node, FILE *out, int target_reg) {
+// lower an expression into IR; returns the vreg holding its value
+static int GenerateExpression(Node *node, IrProgram *ir) {
     if(!node)
         return 0;
     
     // handle NODE_PRINT_PART wrapper
     if(node->node_type == 7) {
-        return GenerateExpression(node->print_part.items, out, target_reg);
+        return GenerateExpression(node->print_part.items, ir);
     }
 
     switch(node->node_type) {
-        case 0: { // NODE_NUM - number literal
-            int reg = target_reg ? target_reg : NewTempRegister();
-            GenerateLoadImmediate(out, reg, node->int_val);
-            return reg;
-        }
+        case 0: // NODE_NUM - number literal
+            return IrEmit(ir, IR_CONST, 0, 0, node->int_val, NULL);
             
-        case 2: { // NODE_ID - variable reference
-            if(target_reg) {
-                // load directly into target register
-                fprintf(out, "ld r%d, %s(r0)\n", target_reg, node->str_val);
-                return target_reg;
-            } else {
-                // load into temporary register
-                int reg = NewTempRegister();
-                fprintf(out, "ld r%d, %s(r0)\n", reg, node->str_val);
-                return reg;
-            }
-        }
+        case 2: // NODE_ID - variable reference
+            return IrEmit(ir, IR_LOAD, 0, 0, 0, node->str_val);
             
         case 3: { // NODE_BINOP - binary operation
-            if(target_reg) {
-                int left_reg = GenerateExpression(node->binop.left, out, 0);
-                int right_reg = GenerateExpression(node->binop.right, out, 0);
-                
-                switch(node->binop.op) {
-                    case '+':
-                        fprintf(out, "daddu r%d, r%d, r%d\n", target_reg, left_reg, right_reg);
-                        break;
-                    case '-':
-                        fprintf(out, "dsubu r%d, r%d, r%d\n", target_reg, left_reg, right_reg);
-                        break;
-                    case '*':
-                        fprintf(out, "dmult r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", target_reg);
-                        break;
-                    case '/':
-                        fprintf(out, "ddiv r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", target_reg);
-                        break;
-                }
-                
-                return target_reg;
-            } else {
-                int left_reg = GenerateExpression(node->binop.left, out, 0);
-                int right_reg = GenerateExpression(node->binop.right, out, 0);
-                int result_reg = NewTempRegister();
-                
-                switch(node->binop.op) {
-                    case '+':
-                        fprintf(out, "daddu r%d, r%d, r%d\n", result_reg, left_reg, right_reg);
-                        break;
-                    case '-':
-                        fprintf(out, "dsubu r%d, r%d, r%d\n", result_reg, left_reg, right_reg);
-                        break;
-                    case '*':
-                        fprintf(out, "dmult r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", result_reg);
-                        break;
-                    case '/':
-                        fprintf(out, "ddiv r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", result_reg);
-                        break;
-                }
-                
-                return result_reg;
+            int left = GenerateExpression(node->binop.left, ir);
+            int right = GenerateExpression(node->binop.right, ir);
+            
+            switch(node->binop.op) {
+                case '+': return IrEmit(ir, IR_ADD, left, right, 0, NULL);
+                case '-': return IrEmit(ir, IR_SUB, left, right, 0, NULL);
+                case '*': return IrEmit(ir, IR_MUL, left, right, 0, NULL);
+                case '/': return IrEmit(ir, IR_DIV, left, right, 0, NULL);
             }
+            break;
         }
     }
     
     return 0;
 }
 
-static void GenerateDeclaration(Node *node, FILE *out) {
+// ch variable = "literal": store the literal's address in the variable
+static void GenerateStringStore(const char *name, const char *text, IrProgram *ir) {
+    char *label = GetStringLabel(text, 0);
+    if(!label)
+        return;
+    int addr = IrEmit(ir, IR_ADDR, 0, 0, 0, label);
+    IrEmit(ir, IR_STORE, addr, 0, 0, name);
+}
+
+static void GenerateDeclaration(Node *node, IrProgram *ir) {
     if(!node || node->node_type != 4)
         return;
     
@@ -383,16 +288,14 @@ static void GenerateDeclaration(Node *node, FILE *out) {
             Node *right = current->binop.right;
             
             // allocate symbol (if not already)
-            if(GetRegisterOfTheSymbol(left->str_val) == -1) {
-                AllocateRegisterForTheSymbol(left->str_val);
+            if(GetVariableOfTheSymbol(left->str_val) == -1) {
+                AllocateVariable(left->str_val);
             }
             mark_initialized(left->str_val);
             
-            // evaluate expression into r4
-            GenerateExpression(right, out, 4);
-            
-            // store from r4 to memory
-            fprintf(out, "sd r4, %s(r0)\n", left->str_val);
+            // evaluate expression and store it to memory
+            int value = GenerateExpression(right, ir);
+            IrEmit(ir, IR_STORE, value, 0, 0, left->str_val);
             
         } else if(current->node_type == 8) {
             // string declaration: ch x = "string"
@@ -403,20 +306,21 @@ static void GenerateDeclaration(Node *node, FILE *out) {
                str_node && str_node->node_type == 1) {
                 // Mark as initialized
                 mark_initialized(id_node->str_val);
+                GenerateStringStore(id_node->str_val, str_node->str_val, ir);
             }
             
         } else if(current->node_type == 2) {
             // simple declaration without initialization
             // Just allocate space, value remains uninitialized
-            if(GetRegisterOfTheSymbol(current->str_val) == -1) {
-                AllocateRegisterForTheSymbol(current->str_val);
+            if(GetVariableOfTheSymbol(current->str_val) == -1) {
+                AllocateVariable(current->str_val);
             }
         }
         current = current->next;
     }
 }
 
-static void GenerateAssignment(Node *node, FILE *out) {
+static void GenerateAssignment(Node *node, IrProgram *ir) {
     if(!node || node->node_type != 5)
         return;
     
@@ -427,11 +331,9 @@ static void GenerateAssignment(Node *node, FILE *out) {
             Node *left = current->binop.left;
             Node *right = current->binop.right;
             
-            // evaluate expression into r4
-            GenerateExpression(right, out, 4);
-            
-            // store from r4 to memory
-            fprintf(out, "sd r4, %s(r0)\n", left->str_val);
+            // evaluate expression and store it to memory
+            int value = GenerateExpression(right, ir);
+            IrEmit(ir, IR_STORE, value, 0, 0, left->str_val);
             mark_initialized(left->str_val);
             
         } else if(current->node_type == 8) {
@@ -441,8 +343,9 @@ static void GenerateAssignment(Node *node, FILE *out) {
             
             if(id_node && id_node->node_type == 2 && 
                str_node && str_node->node_type == 1) {
-                // For string assignment, we update the string value
+                // the variable now points at the new literal
                 mark_initialized(id_node->str_val);
+                GenerateStringStore(id_node->str_val, str_node->str_val, ir);
             }
         }
         current = current->next;
@@ -450,11 +353,12 @@ static void GenerateAssignment(Node *node, FILE *out) {
 }
 
 // generate code for print statement
-static void GeneratePrint(Node *node, FILE *out) {
+static void GeneratePrint(Node *node, IrProgram *ir) {
     if(!node || node->node_type != 6)
         return;
     
     Node *current = node->print_stmt.parts;
+    int ends_with_string = 0;
     
     while(current) {
         Node *content = current;
@@ -465,48 +369,51 @@ static void GeneratePrint(Node *node, FILE *out) {
         if(content && content->node_type == 1) {  // string literal
             char *label = GetStringLabel(content->str_val, 0);
             if(label) {
-                fprintf(out, "daddiu r4, r0, %s\n", label);
-                fprintf(out, "syscall 4\n");
+                int addr = IrEmit(ir, IR_ADDR, 0, 0, 0, label);
+                IrEmit(ir, IR_PRINT_STR, addr, 0, 0, NULL);
             }
         } else if(content && content->node_type == 2) {  // variable
             // Check if it's a string variable
             if(IsStringVariable(content->str_val)) {
-                // String variable - load its address directly
-                fprintf(out, "daddiu r4, r0, %s\n", content->str_val);
-                fprintf(out, "syscall 4\n");
+                // String variable - print the string it points at
+                int addr = IrEmitLoadAddress(ir, content->str_val);
+                IrEmit(ir, IR_PRINT_STR, addr, 0, 0, NULL);
             } else {
                 // Integer variable
-                fprintf(out, "ld r4, %s(r0)\n", content->str_val);
-                fprintf(out, "syscall 1\n");
+                int value = IrEmit(ir, IR_LOAD, 0, 0, 0, content->str_val);
+                IrEmit(ir, IR_PRINT_INT, value, 0, 0, NULL);
             }
         } else if(content) {  // expression
-            GenerateExpression(content, out, 4);
-            fprintf(out, "syscall 1\n");
+            int value = GenerateExpression(content, ir);
+            IrEmit(ir, IR_PRINT_INT, value, 0, 0, NULL);
         }
+        ends_with_string = content && (content->node_type == 1 ||
+                                       (content->node_type == 2 && IsStringVariable(content->str_val)));
         current = current->print_part.part_next;
     }
     
-    // print newline
-    fprintf(out, "daddiu r4, r0, #10\n");
-    fprintf(out, "syscall 11\n");
+    // newline unless the last part was a string (as the interpreter does)
+    if(!ends_with_string) {
+        int newline = IrEmit(ir, IR_CONST, 0, 0, 10, NULL);
+        IrEmit(ir, IR_PRINT_CHAR, newline, 0, 0, NULL);
+    }
 }
 
-// generate code for a single AST node
-void GenerateAssemblyNode(Node *node, FILE *out) {
-    if(!node || !out)
+// lower a single AST statement into IR
+void GenerateAssemblyNode(Node *node, IrProgram *ir) {
+    if(!node || !ir)
         return;
     
-    ResetTempRegister();
-    
+    ir->line = node->line;
     switch(node->node_type) {
         case 4: // NODE_DECL
-            GenerateDeclaration(node, out);
+            GenerateDeclaration(node, ir);
             break;
         case 5: // NODE_ASSIGN
-            GenerateAssignment(node, out);
+            GenerateAssignment(node, ir);
             break;
         case 6: // NODE_PRINT
-            GeneratePrint(node, out);
+            GeneratePrint(node, ir);
             break;
         default:
             // For other nodes, just continue to next statement
@@ -528,33 +435,47 @@ static void PrintStringLiteralsSection(FILE *out) {
     }
 }
 
-// Print string variables section (without _str suffix)
-static void PrintStringVariablesSection(FILE *out) {
-    for(int i = 0; i < string_var_count; i++) {
-        if(string_vars[i].is_initialized) {
-            fprintf(out, "%s: .asciiz \"", string_vars[i].name);
-            for(char *p = string_vars[i].value; *p; p++) {
-                if(*p == '\n') fprintf(out, "\\n");
-                else if(*p == '"') fprintf(out, "\\\"");
-                else if(*p == '\\') fprintf(out, "\\\\");
-                else fputc(*p, out);
-            }
-            fprintf(out, "\"\n");
-        }
+// give every .data item its offset in the order the section is written below,
+// so the .s file, the encoded instructions and the data image agree
+static void LayoutDataSection(const MipsLayout *layout) {
+    ResetDataLayout();
+    PlaceVariables();
+    for(int i = 0; i < string_count; i++) {
+        PlaceSymbol(string_table[i].label, strlen(string_table[i].value) + 1);
+    }
+    for(int i = 0; i < layout->spill_slots; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), SPILL_LABEL_FORMAT, i);
+        PlaceSymbol(label, 8);
+    }
+    for(int i = 0; i < layout->printf_words; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), PRINTF_LABEL_FORMAT, i);
+        PlaceSymbol(label, 8);
+    }
+    FinishDataLayout();
+}
+
+// memory contents: zeros for .space, the strings at their offsets
+static void BuildDataImage(ObjectImage *image) {
+    uint8_t *data = ObjectReserveData(image, GetDataSize());
+    for(int i = 0; i < string_count; i++) {
+        memcpy(data + GetOffsetOfTheSymbol(string_table[i].label), string_table[i].value,
+               strlen(string_table[i].value) + 1);
     }
 }
 
 // generate complete assembly program
-void GenerateAssemblyProgram(Node *program, FILE *out) {
+int GenerateAssemblyProgram(Node *program, FILE *out, const CodegenOptions *options) {
     if(!program || !out)
-        return;
+        return 0;
+    int errors = 0;
     
     // initialize
     SymbolInit();
     AssemblyInit();
     string_count = 0;
     string_label_counter = 0;
-    string_var_count = 0;
     
     // collect all symbols and strings
     CollectSymbolsFromAST(program);
@@ -564,32 +485,108 @@ void GenerateAssemblyProgram(Node *program, FILE *out) {
         AddLabel(string_table[i].label, strlen(string_table[i].value) + 1);
     }
     
+    // lower the AST into three-address IR
+    IrProgram ir;
+    IrInit(&ir);
+    IrNewBlock(&ir);
+    
+    Node *current = program;
+    while(current) {
+        GenerateAssemblyNode(current, &ir);
+        current = current->next;
+    }
+    
+    // exit program
+    ir.line = 0; // not from any statement
+    IrEmit(&ir, IR_EXIT, 0, 0, 0, NULL);
+    
+    if(IrVerify(&ir, stderr) > 0) {
+        fprintf(stderr, "Internal error: code generator produced invalid IR\n");
+        errors++;
+    }
+    
+    IrOptStats opt_stats;
+    if(options && options->optimize) {
+        IrOptimize(&ir, &opt_stats);
+        IrStringPool pool = { LiteralText, LiteralLabel };
+        IrMergePrints(&ir, &pool, &opt_stats);
+        if(IrVerify(&ir, stderr) > 0) {
+            fprintf(stderr, "Internal error: optimizer produced invalid IR\n");
+            errors++;
+        }
+    }
+    if(options && options->ir_dump) {
+        IrDump(&ir, options->ir_dump);
+        if(options->optimize)
+            IrPrintOptStats(&opt_stats, options->ir_dump);
+    }
+    
+    // emit MIPS64 instructions from the IR, then clean up loads and stores
+    InstructionList code;
+    InstructionListInit(&code);
+    MipsLayout layout;
+    EmitMips(&ir, &code, &layout);
+    OptimizeLoadsAndStores(&code);
+    
+    for(int i = 0; i < layout.spill_slots; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), SPILL_LABEL_FORMAT, i);
+        AddLabel(label, 8);
+    }
+    for(int i = 0; i < layout.printf_words; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), PRINTF_LABEL_FORMAT, i);
+        AddLabel(label, 8);
+    }
+    
+    // final offsets, then reach data past 32 KiB through a base register
+    LayoutDataSection(&layout);
+    AddressFarData(&code);
+    
+    // reorder for the pipeline
+    ScheduleStats schedule_stats = { code.count, CountStalls(&code), 0 };
+    if(options && options->schedule)
+        ScheduleInstructions(&code, &schedule_stats);
+    else
+        schedule_stats.stalls_after = schedule_stats.stalls_before;
+    if(options && options->stall_report)
+        PrintScheduleStats(&schedule_stats, options->stall_report);
+    IrFree(&ir);
+    
     // debug: print symbol table
     // PrintAllSymbols(out);
     
     // generate .data section
     fprintf(out, ".data\n");
     
-    // Generate integer variables (from PrintDataSection)
+    // Generate variables (from PrintDataSection)
     PrintDataSection(out);
     
     // Generate string literals (str0, str1, ...)
     PrintStringLiteralsSection(out);
     
-    // Generate string variables WITHOUT _str suffix
-    PrintStringVariablesSection(out);
+    // spill slots for temporaries that did not fit in r10-r19
+    for(int i = 0; i < layout.spill_slots; i++) {
+        fprintf(out, SPILL_LABEL_FORMAT ": .space 8\n", i);
+    }
+    
+    // printf parameter block, one word per label
+    for(int i = 0; i < layout.printf_words; i++) {
+        fprintf(out, PRINTF_LABEL_FORMAT ": .space 8\n", i);
+    }
     
     fprintf(out, "\n.code\n");
     
-    // generate code
-    Node *current = program;
-    while(current) {
-        GenerateAssemblyNode(current, out);
-        current = current->next;
+    PrintInstructionList(&code, out);
+    if(options && options->object) {
+        BuildDataImage(options->object);
+        int unencoded = EncodeInstructions(&code, options->object);
+        if(unencoded > 0) {
+            fprintf(stderr, "Internal error: instructions could not be encoded\n");
+            errors += unencoded;
+        }
     }
-    
-    // exit program
-    fprintf(out, "syscall 10\n");
+    InstructionListFree(&code);
     
     // cleanup
     for(int i = 0; i < string_count; i++) {
@@ -597,12 +594,9 @@ void GenerateAssemblyProgram(Node *program, FILE *out) {
         free(string_table[i].label);
     }
     
-    for(int i = 0; i < string_var_count; i++) {
-        free(string_vars[i].name);
-        free(string_vars[i].value);
-    }
-    
     for(int i = 0; i < init_var_count; i++) {
         free(initialized_vars[i]);
     }
+    SymbolCleanup();
+    return errors;
 }
\ No newline at end of file
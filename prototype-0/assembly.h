@@ -3,9 +3,21 @@
 
 #include <stdio.h>
 #include "ast.h"
+#include "ir.h"
+#include "object_file.h"
+
+// optional extras for GenerateAssemblyProgram
+typedef struct {
+    FILE *ir_dump; // three-address IR listing, NULL to skip
+    int optimize;  // run the SSA optimizer (value numbering, folding, dead code) on the IR
+    int schedule;  // reorder instructions to avoid pipeline stalls
+    FILE *stall_report; // pipeline stall counts before/after scheduling, NULL to skip
+    ObjectImage *object; // .data image and machine code encoded straight from the instructions, NULL to skip
+} CodegenOptions;
 
 void AssemblyInit();
-void GenerateAssemblyProgram(Node *program, FILE *out);
-void GenerateAssemblyNode(Node *node, FILE *out);
+// the number of errors (invalid IR, instructions that could not be encoded); 0 on success
+int GenerateAssemblyProgram(Node *program, FILE *out, const CodegenOptions *options);
+void GenerateAssemblyNode(Node *node, IrProgram *ir);
 
 #endif
\ No newline at end of file
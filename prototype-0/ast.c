@@ -11,7 +11,7 @@ void print_ast(Node *node, int depth) {
     
     printf("Node type: %d", node->node_type);
     switch(node->node_type) {
-        case 0: printf(" (NUM) value: %d\n", node->int_val); break;
+        case 0: printf(" (NUM) value: %lld\n", node->int_val); break;
         case 1: printf(" (STR) value: %s\n", node->str_val); break;
         case 2: printf(" (ID) name: %s\n", node->str_val); break;
         case 3: printf(" (BINOP) op: %c\n", node->binop.op); 
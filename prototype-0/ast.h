@@ -8,9 +8,12 @@
 typedef struct Node {
     int node_type;
     struct Node *next;  // COMMON field for ALL nodes to chain statements
+    int line;           // source line the node was parsed on
+    int slot;           // variable slot of an ID node (-1 until resolve_slots)
+    int str_len;        // length of a STR node's text
     
     union {
-        int int_val;
+        long long int_val;
         char *str_val;
         struct {
             struct Node *left;
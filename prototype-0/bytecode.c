@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "bytecode.h"
+#include "interpreter.h"
+#include "arith.h"
+
+// gcc/clang: every handler jumps straight to the next one (labels as values);
+// anything else (or -DBC_NO_THREADING) gets the same handlers as a switch
+#if defined(__GNUC__) && !defined(BC_NO_THREADING)
+#define BC_THREADED 1
+#endif
+
+static const char *op_names[BC_OP_COUNT] = {
+    [BC_HALT] = "halt",
+    [BC_CONST] = "const",
+    [BC_CONST_WIDE] = "const.wide",
+    [BC_LOAD] = "load",
+    [BC_ADD] = "add",
+    [BC_SUB] = "sub",
+    [BC_MUL] = "mul",
+    [BC_DIV] = "div",
+    [BC_ADD_CONST] = "add.const",
+    [BC_SUB_CONST] = "sub.const",
+    [BC_MUL_CONST] = "mul.const",
+    [BC_DIV_CONST] = "div.const",
+    [BC_ADD_VAR] = "add.var",
+    [BC_SUB_VAR] = "sub.var",
+    [BC_MUL_VAR] = "mul.var",
+    [BC_DIV_VAR] = "div.var",
+    [BC_ASSIGN_ADD_CONST] = "assign.add.const",
+    [BC_ASSIGN_SUB_CONST] = "assign.sub.const",
+    [BC_ASSIGN_MUL_CONST] = "assign.mul.const",
+    [BC_ASSIGN_DIV_CONST] = "assign.div.const",
+    [BC_ASSIGN_ADD_VAR] = "assign.add.var",
+    [BC_ASSIGN_SUB_VAR] = "assign.sub.var",
+    [BC_ASSIGN_MUL_VAR] = "assign.mul.var",
+    [BC_ASSIGN_DIV_VAR] = "assign.div.var",
+    [BC_STORE] = "store",
+    [BC_STORE_STR] = "store.str",
+    [BC_DECLARE] = "declare",
+    [BC_PRINT_INT] = "print.int",
+    [BC_PRINT_STR] = "print.str",
+    [BC_PRINT_VAR] = "print.var",
+    [BC_PRINT_STR_VAR] = "print.str.var",
+    [BC_NEWLINE] = "newline",
+    [BC_NEWLINE_UNLESS_STR] = "newline.unless.str",
+};
+
+const char *bytecode_op_name(BcOp op) {
+    return op >= 0 && op < BC_OP_COUNT ? op_names[op] : "?";
+}
+
+// number of operands after the opcode
+static int operand_count(int op) {
+    switch(op) {
+        case BC_HALT:
+        case BC_ADD:
+        case BC_SUB:
+        case BC_MUL:
+        case BC_DIV:
+        case BC_PRINT_INT:
+        case BC_NEWLINE:
+            return 0;
+        case BC_STORE_STR:
+        case BC_PRINT_STR_VAR:
+            return 2;
+        case BC_ASSIGN_ADD_CONST:
+        case BC_ASSIGN_SUB_CONST:
+        case BC_ASSIGN_MUL_CONST:
+        case BC_ASSIGN_DIV_CONST:
+        case BC_ASSIGN_ADD_VAR:
+        case BC_ASSIGN_SUB_VAR:
+        case BC_ASSIGN_MUL_VAR:
+        case BC_ASSIGN_DIV_VAR:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+// ---- compiler ----
+
+typedef struct {
+    Bytecode *bc;
+    int depth;  // values on the stack at this point of the code
+    int fuse;   // use the superinstructions
+} BcCompiler;
+
+static void emit(BcCompiler *c, int word) {
+    Bytecode *bc = c->bc;
+    if(bc->code_count >= bc->code_capacity) {
+        bc->code_capacity = bc->code_capacity ? bc->code_capacity * 2 : 64;
+        bc->code = realloc(bc->code, sizeof(int) * bc->code_capacity);
+    }
+    bc->code[bc->code_count++] = word;
+}
+
+static void emit_op(BcCompiler *c, BcOp op, int operand) {
+    emit(c, op);
+    if(operand_count(op) > 0)
+        emit(c, operand);
+}
+
+static void push(BcCompiler *c) {
+    if(++c->depth > c->bc->max_stack)
+        c->bc->max_stack = c->depth;
+}
+
+static int add_string(Bytecode *bc, const Node *str) {
+    if(bc->string_count >= bc->string_capacity) {
+        bc->string_capacity = bc->string_capacity ? bc->string_capacity * 2 : 16;
+        bc->strings = realloc(bc->strings, sizeof(char *) * bc->string_capacity);
+        bc->string_lengths = realloc(bc->string_lengths, sizeof(size_t) * bc->string_capacity);
+    }
+    bc->strings[bc->string_count] = strdup(str->str_val);
+    bc->string_lengths[bc->string_count] = str->str_len;
+    return bc->string_count++;
+}
+
+static int add_constant(Bytecode *bc, long long value) {
+    if(bc->constant_count >= bc->constant_capacity) {
+        bc->constant_capacity = bc->constant_capacity ? bc->constant_capacity * 2 : 16;
+        bc->constants = realloc(bc->constants, sizeof(long long) * bc->constant_capacity);
+    }
+    bc->constants[bc->constant_count] = value;
+    return bc->constant_count++;
+}
+
+// a literal can be an operand only if it fits the code array's int
+static int fits_operand(long long value) {
+    return value >= INT_MIN && value <= INT_MAX;
+}
+
+static void emit_literal(BcCompiler *c, long long value) {
+    if(fits_operand(value))
+        emit_op(c, BC_CONST, (int)value);
+    else
+        emit_op(c, BC_CONST_WIDE, add_constant(c->bc, value));
+    push(c);
+}
+
+static int binop_base(int op) {
+    switch(op) {
+        case '+': return BC_ADD;
+        case '-': return BC_SUB;
+        case '*': return BC_MUL;
+        case '/': return BC_DIV;
+        default: return -1;
+    }
+}
+
+// code that leaves the expression's value on the stack (same results as evaluate_expression)
+static void compile_expression(BcCompiler *c, Node *node) {
+    if(!node) {
+        emit_op(c, BC_CONST, 0);
+        push(c);
+        return;
+    }
+    switch(node->node_type) {
+        case 0: // NODE_NUM
+            emit_literal(c, node->int_val);
+            return;
+        case 2: // NODE_ID
+            emit_op(c, BC_LOAD, node->slot);
+            push(c);
+            return;
+        case 3: // NODE_BINOP
+        {
+            int base = binop_base(node->binop.op);
+            if(base < 0) {
+                // '=' gives its left side, anything else 0
+                compile_expression(c, node->binop.op == '=' ? node->binop.left : NULL);
+                return;
+            }
+            Node *right = node->binop.right;
+            compile_expression(c, node->binop.left);
+            // a literal or variable on the right becomes the operand
+            if(right && right->node_type == 0 && fits_operand(right->int_val)) {
+                emit_op(c, base + (BC_ADD_CONST - BC_ADD), (int)right->int_val);
+            } else if(right && right->node_type == 2) {
+                emit_op(c, base + (BC_ADD_VAR - BC_ADD), right->slot);
+            } else {
+                compile_expression(c, right);
+                emit_op(c, base, 0);
+                c->depth--;
+            }
+            return;
+        }
+        default:
+            emit_op(c, BC_CONST, 0);
+            push(c);
+            return;
+    }
+}
+
+// "y op 5" or "y op z": the assign superinstruction for it, with its operands, or -1
+static int match_assign(Node *value, int *left, int *right) {
+    if(!value || value->node_type != 3)
+        return -1;
+    int base = binop_base(value->binop.op);
+    Node *l = value->binop.left;
+    Node *r = value->binop.right;
+    if(base < 0 || !l || l->node_type != 2 || !r)
+        return -1;
+    *left = l->slot;
+    if(r->node_type == 0 && fits_operand(r->int_val)) {
+        *right = (int)r->int_val;
+        return base + (BC_ASSIGN_ADD_CONST - BC_ADD);
+    }
+    if(r->node_type == 2) {
+        *right = r->slot;
+        return base + (BC_ASSIGN_ADD_VAR - BC_ADD);
+    }
+    return -1;
+}
+
+// the items of a declaration or assignment statement
+static void compile_items(BcCompiler *c, Node *item, int is_decl) {
+    for(; item; item = item->next) {
+        int op, left, right;
+        if(item->node_type == 3 && item->binop.op == '=' && c->fuse &&
+           (op = match_assign(item->binop.right, &left, &right)) >= 0) {
+            emit(c, op);
+            emit(c, item->binop.left->slot);
+            emit(c, left);
+            emit(c, right);
+        } else if(item->node_type == 3 && item->binop.op == '=') {
+            compile_expression(c, item->binop.right);
+            emit_op(c, BC_STORE, item->binop.left->slot);
+            c->depth--;
+        } else if(item->node_type == NODE_STR_ASSIGN) {
+            int slot = item->str_assign.id->slot;
+            emit(c, BC_STORE_STR);
+            emit(c, slot);
+            emit(c, add_string(c->bc, item->str_assign.str));
+        } else if(item->node_type == 2 && is_decl) {
+            emit_op(c, BC_DECLARE, item->slot);
+        }
+    }
+}
+
+static void compile_print(BcCompiler *c, Node *part) {
+    Node *last = NULL;
+    for(; part; part = part->print_part.part_next) {
+        if(part->node_type != NODE_PRINT_PART)
+            continue;
+        Node *content = part->print_part.items;
+        Node *next = part->print_part.part_next;
+        // "literal", variable at the end of the statement: one dispatch, newline included
+        if(c->fuse && content->node_type == 1 && next && next->node_type == NODE_PRINT_PART &&
+           !next->print_part.part_next && next->print_part.items->node_type == 2) {
+            emit(c, BC_PRINT_STR_VAR);
+            emit(c, add_string(c->bc, content));
+            emit(c, next->print_part.items->slot);
+            return;
+        }
+        if(content->node_type == 1) {
+            emit_op(c, BC_PRINT_STR, add_string(c->bc, content));
+        } else if(content->node_type == 2) {
+            emit_op(c, BC_PRINT_VAR, content->slot);
+        } else {
+            compile_expression(c, content);
+            emit_op(c, BC_PRINT_INT, 0);
+            c->depth--;
+        }
+        last = content;
+    }
+    // no newline after a string, whether a literal or in a variable
+    if(!last || last->node_type == 1)
+        return;
+    if(last->node_type == 2)
+        emit_op(c, BC_NEWLINE_UNLESS_STR, last->slot);
+    else
+        emit_op(c, BC_NEWLINE, 0);
+}
+
+static Bytecode *compile_program(Node *program, int fuse) {
+    BcCompiler c;
+    c.bc = calloc(1, sizeof(Bytecode));
+    c.depth = 0;
+    c.fuse = fuse;
+
+    const char **names;
+    c.bc->slot_count = resolve_slots(program, &names);
+    c.bc->slot_names = malloc(sizeof(char *) * (c.bc->slot_count ? c.bc->slot_count : 1));
+    for(int i = 0; i < c.bc->slot_count; i++) {
+        c.bc->slot_names[i] = strdup(names[i]);
+    }
+    free(names);
+
+    for(Node *statement = program; statement; statement = statement->next) {
+        switch(statement->node_type) {
+            case 4: // NODE_DECL
+                compile_items(&c, statement->decl_assign.items, 1);
+                break;
+            case 5: // NODE_ASSIGN
+                compile_items(&c, statement->decl_assign.items, 0);
+                break;
+            case 6: // NODE_PRINT
+                compile_print(&c, statement->print_stmt.parts);
+                break;
+            default:
+                break;
+        }
+    }
+    emit_op(&c, BC_HALT, 0);
+    return c.bc;
+}
+
+Bytecode *bytecode_compile(Node *program) {
+    return compile_program(program, 1);
+}
+
+Bytecode *bytecode_compile_unfused(Node *program) {
+    return compile_program(program, 0);
+}
+
+int bytecode_dispatch_count(const Bytecode *bytecode) {
+    int count = 0;
+    for(int pc = 0; pc < bytecode->code_count; pc += 1 + operand_count(bytecode->code[pc])) {
+        count++;
+    }
+    return count;
+}
+
+void bytecode_free(Bytecode *bytecode) {
+    if(!bytecode)
+        return;
+    for(int i = 0; i < bytecode->string_count; i++) {
+        free(bytecode->strings[i]);
+    }
+    for(int i = 0; i < bytecode->slot_count; i++) {
+        free(bytecode->slot_names[i]);
+    }
+    free(bytecode->strings);
+    free(bytecode->string_lengths);
+    free(bytecode->constants);
+    free(bytecode->slot_names);
+    free(bytecode->code);
+    free(bytecode);
+}
+
+void bytecode_dump(const Bytecode *bytecode, FILE *out) {
+    const int *code = bytecode->code;
+    for(int pc = 0; pc < bytecode->code_count; pc += 1 + operand_count(code[pc])) {
+        int op = code[pc];
+        fprintf(out, "%5d  %-19s", pc, bytecode_op_name(op));
+        switch(op) {
+            case BC_CONST:
+            case BC_ADD_CONST:
+            case BC_SUB_CONST:
+            case BC_MUL_CONST:
+            case BC_DIV_CONST:
+                fprintf(out, "%d", code[pc + 1]);
+                break;
+            case BC_CONST_WIDE:
+                fprintf(out, "%lld", bytecode->constants[code[pc + 1]]);
+                break;
+            case BC_PRINT_STR:
+                fprintf(out, "\"%s\"", bytecode->strings[code[pc + 1]]);
+                break;
+            case BC_STORE_STR:
+                fprintf(out, "%s, \"%s\"", bytecode->slot_names[code[pc + 1]], bytecode->strings[code[pc + 2]]);
+                break;
+            case BC_PRINT_STR_VAR:
+                fprintf(out, "\"%s\", %s", bytecode->strings[code[pc + 1]], bytecode->slot_names[code[pc + 2]]);
+                break;
+            case BC_ASSIGN_ADD_CONST:
+            case BC_ASSIGN_SUB_CONST:
+            case BC_ASSIGN_MUL_CONST:
+            case BC_ASSIGN_DIV_CONST:
+                fprintf(out, "%s, %s, %d", bytecode->slot_names[code[pc + 1]], bytecode->slot_names[code[pc + 2]],
+                        code[pc + 3]);
+                break;
+            case BC_ASSIGN_ADD_VAR:
+            case BC_ASSIGN_SUB_VAR:
+            case BC_ASSIGN_MUL_VAR:
+            case BC_ASSIGN_DIV_VAR:
+                fprintf(out, "%s, %s, %s", bytecode->slot_names[code[pc + 1]], bytecode->slot_names[code[pc + 2]],
+                        bytecode->slot_names[code[pc + 3]]);
+                break;
+            default:
+                if(operand_count(op) > 0)
+                    fprintf(out, "%s", bytecode->slot_names[code[pc + 1]]);
+                break;
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// ---- VM ----
+
+// integer is kept 0 while the slot is uninitialized or holds a string, so loading it is
+// a plain read
+typedef struct {
+    long long integer;
+    const char *string;  // NULL unless the slot holds a string
+    size_t string_length;
+    bool initialized;
+} BcSlot;
+
+static inline void assign(BcSlot *slot, long long value) {
+    slot->integer = value;
+    slot->string = NULL;
+    slot->initialized = true;
+}
+
+// as it is: its string, its integer, or 0
+static inline void print_slot(OutputCapture *out, const BcSlot *slot) {
+    if(!slot->initialized)
+        capture_append(out, "0", 1);
+    else if(slot->string)
+        capture_append(out, slot->string, slot->string_length);
+    else
+        capture_int(out, slot->integer);
+}
+
+void bytecode_run(const Bytecode *bytecode, OutputCapture *out) {
+    BcSlot *slots = calloc(bytecode->slot_count ? bytecode->slot_count : 1, sizeof(BcSlot));
+    long long *stack = malloc(sizeof(long long) * (bytecode->max_stack + 1));
+    long long *sp = stack; // one past the top
+    const int *pc = bytecode->code;
+    const long long *constants = bytecode->constants;
+    char *const *strings = bytecode->strings;
+    const size_t *string_lengths = bytecode->string_lengths;
+
+#ifdef BC_THREADED
+    static void *handlers[BC_OP_COUNT] = {
+        [BC_HALT] = &&op_halt,
+        [BC_CONST] = &&op_const,
+        [BC_CONST_WIDE] = &&op_const_wide,
+        [BC_LOAD] = &&op_load,
+        [BC_ADD] = &&op_add,
+        [BC_SUB] = &&op_sub,
+        [BC_MUL] = &&op_mul,
+        [BC_DIV] = &&op_div,
+        [BC_ADD_CONST] = &&op_add_const,
+        [BC_SUB_CONST] = &&op_sub_const,
+        [BC_MUL_CONST] = &&op_mul_const,
+        [BC_DIV_CONST] = &&op_div_const,
+        [BC_ADD_VAR] = &&op_add_var,
+        [BC_SUB_VAR] = &&op_sub_var,
+        [BC_MUL_VAR] = &&op_mul_var,
+        [BC_DIV_VAR] = &&op_div_var,
+        [BC_ASSIGN_ADD_CONST] = &&op_assign_add_const,
+        [BC_ASSIGN_SUB_CONST] = &&op_assign_sub_const,
+        [BC_ASSIGN_MUL_CONST] = &&op_assign_mul_const,
+        [BC_ASSIGN_DIV_CONST] = &&op_assign_div_const,
+        [BC_ASSIGN_ADD_VAR] = &&op_assign_add_var,
+        [BC_ASSIGN_SUB_VAR] = &&op_assign_sub_var,
+        [BC_ASSIGN_MUL_VAR] = &&op_assign_mul_var,
+        [BC_ASSIGN_DIV_VAR] = &&op_assign_div_var,
+        [BC_STORE] = &&op_store,
+        [BC_STORE_STR] = &&op_store_str,
+        [BC_DECLARE] = &&op_declare,
+        [BC_PRINT_INT] = &&op_print_int,
+        [BC_PRINT_STR] = &&op_print_str,
+        [BC_PRINT_VAR] = &&op_print_var,
+        [BC_PRINT_STR_VAR] = &&op_print_str_var,
+        [BC_NEWLINE] = &&op_newline,
+        [BC_NEWLINE_UNLESS_STR] = &&op_newline_unless_str,
+    };
+#define HANDLER(name, op) name:
+#define NEXT() goto *handlers[*pc++]
+    NEXT();
+#else
+#define HANDLER(name, op) case op:
+#define NEXT() goto dispatch
+dispatch:
+    switch(*pc++) {
+#endif
+// binary operators in their stack, constant and slot operand forms, and as whole assignments
+#define ARITHMETIC(name, op, apply) \
+    HANDLER(op_##name, BC_##op) \
+        sp--; \
+        sp[-1] = apply(sp[-1], sp[0]); \
+        NEXT(); \
+    HANDLER(op_##name##_const, BC_##op##_CONST) \
+        sp[-1] = apply(sp[-1], *pc++); \
+        NEXT(); \
+    HANDLER(op_##name##_var, BC_##op##_VAR) \
+        sp[-1] = apply(sp[-1], slots[*pc++].integer); \
+        NEXT(); \
+    HANDLER(op_assign_##name##_const, BC_ASSIGN_##op##_CONST) \
+        assign(&slots[pc[0]], apply(slots[pc[1]].integer, pc[2])); \
+        pc += 3; \
+        NEXT(); \
+    HANDLER(op_assign_##name##_var, BC_ASSIGN_##op##_VAR) \
+        assign(&slots[pc[0]], apply(slots[pc[1]].integer, slots[pc[2]].integer)); \
+        pc += 3; \
+        NEXT();
+
+    HANDLER(op_const, BC_CONST)
+        *sp++ = *pc++;
+        NEXT();
+    HANDLER(op_const_wide, BC_CONST_WIDE)
+        *sp++ = constants[*pc++];
+        NEXT();
+    HANDLER(op_load, BC_LOAD)
+        *sp++ = slots[*pc++].integer;
+        NEXT();
+    ARITHMETIC(add, ADD, arith_add)
+    ARITHMETIC(sub, SUB, arith_sub)
+    ARITHMETIC(mul, MUL, arith_mul)
+    ARITHMETIC(div, DIV, arith_div)
+    HANDLER(op_store, BC_STORE)
+        assign(&slots[*pc++], *--sp);
+        NEXT();
+    HANDLER(op_store_str, BC_STORE_STR)
+    {
+        BcSlot *slot = &slots[*pc++];
+        int string = *pc++;
+        slot->integer = 0;
+        slot->string = strings[string];
+        slot->string_length = string_lengths[string];
+        slot->initialized = true;
+        NEXT();
+    }
+    HANDLER(op_declare, BC_DECLARE)
+    {
+        // like the tree walker, a string declared again keeps its text but reads as 0
+        BcSlot *slot = &slots[*pc++];
+        slot->integer = 0;
+        slot->initialized = false;
+        NEXT();
+    }
+    HANDLER(op_print_int, BC_PRINT_INT)
+        capture_int(out, *--sp);
+        NEXT();
+    HANDLER(op_print_str, BC_PRINT_STR)
+        capture_append(out, strings[*pc], string_lengths[*pc]);
+        pc++;
+        NEXT();
+    HANDLER(op_print_var, BC_PRINT_VAR)
+        print_slot(out, &slots[*pc++]);
+        NEXT();
+    HANDLER(op_print_str_var, BC_PRINT_STR_VAR)
+    {
+        const BcSlot *slot = &slots[pc[1]];
+        capture_append(out, strings[pc[0]], string_lengths[pc[0]]);
+        print_slot(out, slot);
+        if(!slot->string)
+            capture_append(out, "\n", 1);
+        pc += 2;
+        NEXT();
+    }
+    HANDLER(op_newline, BC_NEWLINE)
+        capture_append(out, "\n", 1);
+        NEXT();
+    HANDLER(op_newline_unless_str, BC_NEWLINE_UNLESS_STR)
+        if(!slots[*pc++].string)
+            capture_append(out, "\n", 1);
+        NEXT();
+    HANDLER(op_halt, BC_HALT)
+        goto done;
+#ifndef BC_THREADED
+    }
+#endif
+#undef ARITHMETIC
+#undef HANDLER
+#undef NEXT
+
+done:
+    free(stack);
+    free(slots);
+}
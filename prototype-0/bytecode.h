@@ -0,0 +1,83 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "ast.h"
+#include "output.h"
+
+// stack bytecode for the interpreter: variables are resolved to slot numbers and literals
+// become instruction operands when the program is compiled, so running it never looks at
+// the AST or compares a name; values are 64-bit, as in the tree walker and on the target
+typedef enum {
+    BC_HALT = 0,
+    BC_CONST,              // push operand
+    BC_CONST_WIDE,         // push constants[operand] (a literal that does not fit an int operand)
+    BC_LOAD,               // push the integer in slot (0 if uninitialized or a string)
+    BC_ADD,                // pop right, pop left, push left op right
+    BC_SUB,
+    BC_MUL,
+    BC_DIV,                // x / 0 is 0
+    BC_ADD_CONST,          // top = top op operand (literals that fit an int)
+    BC_SUB_CONST,
+    BC_MUL_CONST,
+    BC_DIV_CONST,
+    BC_ADD_VAR,            // top = top op integer in slot
+    BC_SUB_VAR,
+    BC_MUL_VAR,
+    BC_DIV_VAR,
+    BC_ASSIGN_ADD_CONST,   // operands x, y, literal: x = integer in y op literal, one dispatch
+    BC_ASSIGN_SUB_CONST,
+    BC_ASSIGN_MUL_CONST,
+    BC_ASSIGN_DIV_CONST,
+    BC_ASSIGN_ADD_VAR,     // operands x, y, z: x = integer in y op integer in z
+    BC_ASSIGN_SUB_VAR,
+    BC_ASSIGN_MUL_VAR,
+    BC_ASSIGN_DIV_VAR,
+    BC_STORE,              // pop into slot
+    BC_STORE_STR,          // slot = string constant
+    BC_DECLARE,            // slot is uninitialized again
+    BC_PRINT_INT,          // pop and print
+    BC_PRINT_STR,          // print string constant
+    BC_PRINT_VAR,          // print slot as it is: its string, its integer, or 0
+    BC_PRINT_STR_VAR,      // operands string, slot: print.str, print.var, newline.unless.str
+    BC_NEWLINE,
+    BC_NEWLINE_UNLESS_STR, // newline unless slot holds a string
+    BC_OP_COUNT
+} BcOp;
+
+// code is opcodes followed by their operands (ints); the assign and print.str.var forms are
+// superinstructions for the commonest statement shapes, picked out of the AST when compiling
+typedef struct {
+    int *code;
+    int code_count;
+    int code_capacity;
+    char **strings;      // string constants, owned
+    size_t *string_lengths;
+    int string_count;
+    int string_capacity;
+    long long *constants; // literals too wide to be operands
+    int constant_count;
+    int constant_capacity;
+    char **slot_names;   // variable of each slot (numbered by resolve_slots), owned
+    int slot_count;
+    int max_stack;       // deepest expression
+} Bytecode;
+
+// program is the statement list of the AST; its ID nodes get their slots, and it is not
+// referenced afterwards
+Bytecode *bytecode_compile(Node *program);
+// the same without superinstructions, for comparison
+Bytecode *bytecode_compile_unfused(Node *program);
+void bytecode_free(Bytecode *bytecode);
+
+// run on fresh variables, appending what the program prints to out
+// the dispatch loop is threaded (computed goto) on gcc/clang unless -DBC_NO_THREADING
+void bytecode_run(const Bytecode *bytecode, OutputCapture *out);
+
+// instructions one run dispatches (code is straight-line, so every one of them, halt included)
+int bytecode_dispatch_count(const Bytecode *bytecode);
+
+// one instruction per line
+void bytecode_dump(const Bytecode *bytecode, FILE *out);
+const char *bytecode_op_name(BcOp op);
+
+#endif
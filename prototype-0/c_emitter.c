@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "c_emitter.h"
+#include "interpreter.h"
+
+// everything the generated main needs: the language's arithmetic (arith.h) and the output buffer
+static const char prelude[] =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static inline int64_t P0Add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }\n"
+    "static inline int64_t P0Sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }\n"
+    "static inline int64_t P0Mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }\n"
+    "\n"
+    "// x / 0 is 0; INT64_MIN / -1 wraps\n"
+    "static inline int64_t P0Div(int64_t a, int64_t b) {\n"
+    "    if(b == 0)\n"
+    "        return 0;\n"
+    "    if(b == -1)\n"
+    "        return P0Sub(0, a);\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n"
+    "static char out_buffer[64 * 1024];\n"
+    "static size_t out_size;\n"
+    "\n"
+    "static void OutFlush(void) {\n"
+    "    fwrite(out_buffer, 1, out_size, stdout);\n"
+    "    out_size = 0;\n"
+    "}\n"
+    "\n"
+    "static inline void OutBytes(const char *text, size_t length) {\n"
+    "    if(length > sizeof(out_buffer) - out_size) {\n"
+    "        OutFlush();\n"
+    "        if(length > sizeof(out_buffer)) {\n"
+    "            fwrite(text, 1, length, stdout);\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "    memcpy(out_buffer + out_size, text, length);\n"
+    "    out_size += length;\n"
+    "}\n"
+    "\n"
+    "static inline void OutInt(int64_t value) {\n"
+    "    char digits[24];\n"
+    "    char *p = digits + sizeof(digits);\n"
+    "    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;\n"
+    "    do {\n"
+    "        *--p = (char)('0' + magnitude % 10);\n"
+    "        magnitude /= 10;\n"
+    "    } while(magnitude);\n"
+    "    if(value < 0)\n"
+    "        *--p = '-';\n"
+    "    OutBytes(p, (size_t)(digits + sizeof(digits) - p));\n"
+    "}\n"
+    "\n";
+
+// what a variable holds at the current statement
+typedef struct {
+    const Node *string; // STR node of the text it holds, NULL if none
+    int initialized;
+} CVariable;
+
+typedef struct {
+    FILE *out;
+    const char **names;
+    CVariable *vars;
+    char *pending;      // constant output not written yet, merged into one OutBytes
+    size_t pending_size;
+    size_t pending_capacity;
+} CEmitter;
+
+static void AppendPending(CEmitter *em, const char *text, size_t length) {
+    if(em->pending_size + length > em->pending_capacity) {
+        em->pending_capacity = em->pending_capacity ? em->pending_capacity * 2 : 256;
+        while(em->pending_size + length > em->pending_capacity)
+            em->pending_capacity *= 2;
+        em->pending = realloc(em->pending, em->pending_capacity);
+    }
+    memcpy(em->pending + em->pending_size, text, length);
+    em->pending_size += length;
+}
+
+// bytes as a C string literal: anything but plain printable characters is an octal escape
+static void WriteCString(FILE *out, const char *text, size_t length) {
+    fputc('"', out);
+    for(size_t i = 0; i < length; i++) {
+        unsigned char ch = (unsigned char)text[i];
+        if(ch < 0x20 || ch >= 0x7F || ch == '"' || ch == '\\' || ch == '?')
+            fprintf(out, "\\%03o", ch);
+        else
+            fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+static void FlushPending(CEmitter *em) {
+    if(!em->pending_size)
+        return;
+    fprintf(em->out, "    OutBytes(");
+    WriteCString(em->out, em->pending, em->pending_size);
+    fprintf(em->out, ", %zu);\n", em->pending_size);
+    em->pending_size = 0;
+}
+
+// a C expression with the value evaluate_expression gives
+static void WriteExpression(CEmitter *em, const Node *node) {
+    FILE *out = em->out;
+    if(!node) {
+        fprintf(out, "0");
+        return;
+    }
+    switch(node->node_type) {
+        case 0: // NODE_NUM
+            if(node->int_val == INT64_MIN)
+                fprintf(out, "INT64_MIN");
+            else
+                fprintf(out, "INT64_C(%lld)", node->int_val);
+            return;
+        case 2: // NODE_ID
+            fprintf(out, "v_%s", em->names[node->slot]);
+            return;
+        case 3: { // NODE_BINOP
+            const char *function = NULL;
+            switch(node->binop.op) {
+                case '+': function = "P0Add"; break;
+                case '-': function = "P0Sub"; break;
+                case '*': function = "P0Mul"; break;
+                case '/': function = "P0Div"; break;
+                case '=':
+                    WriteExpression(em, node->binop.left);
+                    return;
+                default:
+                    fprintf(out, "0");
+                    return;
+            }
+            fprintf(out, "%s(", function);
+            WriteExpression(em, node->binop.left);
+            fprintf(out, ", ");
+            WriteExpression(em, node->binop.right);
+            fprintf(out, ")");
+            return;
+        }
+        default:
+            fprintf(out, "0");
+            return;
+    }
+}
+
+// the items of a declaration or assignment statement
+static void GenerateItems(CEmitter *em, const Node *item, int is_decl) {
+    for(; item; item = item->next) {
+        if(item->node_type == 3 && item->binop.op == '=') {
+            const Node *id = item->binop.left;
+            fprintf(em->out, "    v_%s = ", em->names[id->slot]);
+            WriteExpression(em, item->binop.right);
+            fprintf(em->out, ";\n");
+            em->vars[id->slot].string = NULL;
+            em->vars[id->slot].initialized = 1;
+        } else if(item->node_type == NODE_STR_ASSIGN) {
+            // the text itself is only needed where it is printed
+            int slot = item->str_assign.id->slot;
+            fprintf(em->out, "    v_%s = 0;\n", em->names[slot]);
+            em->vars[slot].string = item->str_assign.str;
+            em->vars[slot].initialized = 1;
+        } else if(item->node_type == 2 && is_decl) {
+            // like the interpreters, a string declared again keeps its text but reads as 0
+            fprintf(em->out, "    v_%s = 0;\n", em->names[item->slot]);
+            em->vars[item->slot].initialized = 0;
+        }
+    }
+}
+
+static void GeneratePrint(CEmitter *em, const Node *part) {
+    const Node *last = NULL;
+    for(; part; part = part->print_part.part_next) {
+        if(part->node_type != NODE_PRINT_PART)
+            continue;
+        const Node *content = part->print_part.items;
+        const CVariable *var = content->node_type == 2 ? &em->vars[content->slot] : NULL;
+        if(content->node_type == 1) {
+            AppendPending(em, content->str_val, content->str_len);
+        } else if(var && !var->initialized) {
+            AppendPending(em, "0", 1);
+        } else if(var && var->string) {
+            AppendPending(em, var->string->str_val, var->string->str_len);
+        } else if(content->node_type == 0) {
+            char digits[24];
+            int length = snprintf(digits, sizeof(digits), "%lld", content->int_val);
+            AppendPending(em, digits, length);
+        } else {
+            FlushPending(em);
+            fprintf(em->out, "    OutInt(");
+            WriteExpression(em, content);
+            fprintf(em->out, ");\n");
+        }
+        last = content;
+    }
+    // no newline after a string, whether a literal or in a variable
+    if(!last || last->node_type == 1)
+        return;
+    if(last->node_type == 2 && em->vars[last->slot].string)
+        return;
+    AppendPending(em, "\n", 1);
+}
+
+void GenerateCProgram(Node *program, FILE *out) {
+    CEmitter em = { out, NULL, NULL, NULL, 0, 0 };
+    int slot_count = resolve_slots(program, &em.names);
+    em.vars = calloc(slot_count ? slot_count : 1, sizeof(CVariable));
+
+    fputs(prelude, out);
+    fprintf(out, "int main(void) {\n");
+    for(int i = 0; i < slot_count; i++) {
+        fprintf(out, "    int64_t v_%s = 0;\n", em.names[i]);
+    }
+    for(const Node *statement = program; statement; statement = statement->next) {
+        switch(statement->node_type) {
+            case 4: // NODE_DECL
+                GenerateItems(&em, statement->decl_assign.items, 1);
+                break;
+            case 5: // NODE_ASSIGN
+                GenerateItems(&em, statement->decl_assign.items, 0);
+                break;
+            case 6: // NODE_PRINT
+                GeneratePrint(&em, statement->print_stmt.parts);
+                break;
+            default:
+                break;
+        }
+    }
+    FlushPending(&em);
+    // variables that are only ever assigned would otherwise draw unused warnings
+    for(int i = 0; i < slot_count; i++) {
+        fprintf(out, "    (void)v_%s;\n", em.names[i]);
+    }
+    fprintf(out, "    OutFlush();\n");
+    fprintf(out, "    return 0;\n");
+    fprintf(out, "}\n");
+
+    free(em.pending);
+    free(em.vars);
+    free(em.names);
+}
+
+int BuildNativeExecutable(const char *c_filename, const char *exe_filename) {
+    const char *cc = getenv("CC");
+    if(!cc || !*cc)
+        cc = "cc";
+    size_t size = strlen(cc) + strlen(c_filename) + strlen(exe_filename) + 32;
+    char *command = malloc(size);
+    snprintf(command, size, "%s -O2 -o '%s' '%s'", cc, exe_filename, c_filename);
+    fflush(stdout); // the compiler's messages come after ours
+    int status = system(command);
+    if(status != 0)
+        fprintf(stderr, "Error: \"%s\" failed\n", command);
+    free(command);
+    return status == 0;
+}
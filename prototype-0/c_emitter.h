@@ -0,0 +1,17 @@
+#ifndef C_EMITTER_H
+#define C_EMITTER_H
+
+#include <stdio.h>
+#include "ast.h"
+
+// the program as a standalone C file: every variable is an int64_t local, arithmetic wraps at
+// 64 bits like the MIPS64 code, and output goes through one buffer written with fwrite;
+// code is straight-line, so whether a variable holds a string (and which) is known at each
+// print and needs no run-time tag
+// program's ID nodes get their slots (resolve_slots)
+void GenerateCProgram(Node *program, FILE *out);
+
+// run the system C compiler ($CC, or cc) with -O2 on c_filename; 1 if it succeeded
+int BuildNativeExecutable(const char *c_filename, const char *exe_filename);
+
+#endif
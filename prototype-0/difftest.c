@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "difftest.h"
+#include "asm_buffer.h"
+
+#define MAX_VARS 96
+#define EXPR_SIZE 512
+#define EXPR_DEPTH 3
+#define EXPR_TRIES 8
+#define PRINT_ITEMS 4
+
+// xorshift64*: small, fast and the same on every platform
+typedef struct {
+    uint64_t state;
+} Random;
+
+static uint64_t NextRandom(Random *r) {
+    r->state ^= r->state >> 12;
+    r->state ^= r->state << 25;
+    r->state ^= r->state >> 27;
+    return r->state * 0x2545F4914F6CDD1DULL;
+}
+
+static int Below(Random *r, int n) {
+    return (int)(NextRandom(r) % (uint64_t)n);
+}
+
+typedef struct {
+    Random rng;
+    int wide;
+    int quiet;
+    long long limit;              // largest magnitude any value may reach
+    long long ints[MAX_VARS];     // current value of v<i>
+    int int_count;
+    int str_count;                // s0 .. s<str_count-1>
+    AsmBuffer text;
+} Generator;
+
+// operator precedence of a generated expression: leaves and parenthesized ones bind tightest
+enum { PREC_ADD = 1, PREC_MUL = 2, PREC_LEAF = 3 };
+
+static void GenLeaf(Generator *g, char *out, size_t size, long long *value, int *prec) {
+    *prec = PREC_LEAF;
+    if(g->int_count > 0 && Below(&g->rng, 3) == 0) {
+        int v = Below(&g->rng, g->int_count);
+        snprintf(out, size, "v%d", v);
+        *value = g->ints[v];
+        return;
+    }
+    // mostly small numbers, now and then up to the limit (wide: of any width up to 64 bits,
+    // so every length of load-immediate sequence comes up)
+    long long n;
+    if(Below(&g->rng, 4) == 0) {
+        n = (long long)(NextRandom(&g->rng) % ((uint64_t)g->limit + 1));
+        if(g->wide)
+            n >>= Below(&g->rng, 63);
+    } else {
+        n = Below(&g->rng, 100);
+    }
+    snprintf(out, size, "%lld", n);
+    *value = n;
+}
+
+// the value C (and MIPS64) arithmetic gives, wrapping instead of overflowing
+static long long Apply(char op, long long a, long long b) {
+    switch(op) {
+        case '+': return (long long)((uint64_t)a + (uint64_t)b);
+        case '-': return (long long)((uint64_t)a - (uint64_t)b);
+        case '*': return (long long)((uint64_t)a * (uint64_t)b);
+        default:
+            if(b == 0)
+                return 0; // both engines define x/0 as 0
+            return b == -1 ? (long long)(0 - (uint64_t)a) : a / b;
+    }
+}
+
+// each operand gets a little under half of the room, which is plenty for EXPR_DEPTH levels
+static void GenExpr(Generator *g, int depth, char *out, size_t size, long long *value, int *prec) {
+    if(depth == 0 || Below(&g->rng, 3) == 0) {
+        GenLeaf(g, out, size, value, prec);
+        return;
+    }
+    char left[EXPR_SIZE / 2], right[EXPR_SIZE / 2];
+    size_t half = (size - 8) / 2;
+    for(int tries = 0; tries < EXPR_TRIES; tries++) {
+        char op = "+-*/"[Below(&g->rng, 4)];
+        int op_prec = (op == '+' || op == '-') ? PREC_ADD : PREC_MUL;
+        long long a, b;
+        int left_prec, right_prec;
+        GenExpr(g, depth - 1, left, half, &a, &left_prec);
+        GenExpr(g, depth - 1, right, half, &b, &right_prec);
+        if(op == '/' && strcmp(right, "0") == 0)
+            continue; // a literal zero divisor is a compile error
+        long long result = Apply(op, a, b);
+        if(!g->wide && (result > g->limit || result < -g->limit))
+            continue;
+
+        // parentheses where precedence needs them (and sometimes where it does not)
+        int wrap_left = left_prec < op_prec || (left_prec != PREC_LEAF && Below(&g->rng, 4) == 0);
+        int wrap_right = right_prec <= op_prec || (right_prec != PREC_LEAF && Below(&g->rng, 4) == 0);
+        snprintf(out, size, "%s%s%s %c %s%s%s", wrap_left ? "(" : "", left, wrap_left ? ")" : "",
+                 op, wrap_right ? "(" : "", right, wrap_right ? ")" : "");
+        *value = result;
+        *prec = op_prec;
+        return;
+    }
+    GenLeaf(g, out, size, value, prec);
+}
+
+// string literal pieces, escapes and printf directives included
+static const char *const string_pieces[] = {
+    "a", "b", "Z", "x", " ", "  ", "=", ":", ",", "-", "0", "42", "%", "%d", "%s",
+    "\\n", "\\t", "\\\"", "\\\\"
+};
+
+static void GenString(Generator *g) {
+    AsmPutString(&g->text, "\"");
+    int pieces = Below(&g->rng, 6);
+    for(int i = 0; i < pieces; i++) {
+        AsmPutString(&g->text, string_pieces[Below(&g->rng, sizeof(string_pieces) / sizeof(string_pieces[0]))]);
+    }
+    AsmPutString(&g->text, "\"");
+}
+
+static void PutExpr(Generator *g, long long *value) {
+    char expr[EXPR_SIZE];
+    int prec;
+    GenExpr(g, Below(&g->rng, EXPR_DEPTH + 1), expr, sizeof(expr), value, &prec);
+    AsmPutString(&g->text, expr);
+}
+
+static void PutName(Generator *g, char kind, int index) {
+    char *p = AsmReserve(&g->text, 24);
+    *p++ = kind;
+    AsmCommit(&g->text, FormatInt(p, index));
+}
+
+static void GenPrint(Generator *g) {
+    AsmPutString(&g->text, "p: ");
+    int items = 1 + Below(&g->rng, PRINT_ITEMS);
+    for(int i = 0; i < items; i++) {
+        if(i > 0)
+            AsmPutString(&g->text, ", ");
+        int kind = Below(&g->rng, 4);
+        long long value;
+        if(kind == 0) {
+            GenString(g);
+        } else if(kind == 1 && g->str_count > 0) {
+            PutName(g, 's', Below(&g->rng, g->str_count));
+        } else if(kind == 2 && g->int_count > 0) {
+            PutName(g, 'v', Below(&g->rng, g->int_count));
+        } else {
+            PutExpr(g, &value);
+        }
+    }
+}
+
+static void GenStatement(Generator *g) {
+    // kinds 13 and up print
+    int kind = Below(&g->rng, g->quiet ? 14 : 20);
+    long long value = 0;
+    if(kind < 5 && g->int_count < MAX_VARS) {
+        // int v = expr, sometimes without a value
+        AsmPutString(&g->text, "int ");
+        PutName(g, 'v', g->int_count);
+        if(Below(&g->rng, 4) != 0) {
+            AsmPutString(&g->text, " = ");
+            PutExpr(g, &value);
+        }
+        g->ints[g->int_count++] = value;
+    } else if(kind < 7 && g->str_count < MAX_VARS) {
+        AsmPutString(&g->text, "ch ");
+        PutName(g, 's', g->str_count++);
+        if(Below(&g->rng, 3) != 0) {
+            AsmPutString(&g->text, " = ");
+            GenString(g);
+        }
+    } else if(kind < 12 && g->int_count > 0) {
+        int v = Below(&g->rng, g->int_count);
+        PutName(g, 'v', v);
+        AsmPutString(&g->text, " = ");
+        PutExpr(g, &value);
+        g->ints[v] = value;
+    } else if(kind < 13 && g->str_count > 0) {
+        PutName(g, 's', Below(&g->rng, g->str_count));
+        AsmPutString(&g->text, " = ");
+        GenString(g);
+    } else {
+        GenPrint(g);
+    }
+    AsmPutString(&g->text, "\n");
+}
+
+char *DiffGenerateProgram(uint64_t seed, const DiffGenOptions *options) {
+    Generator g;
+    memset(&g, 0, sizeof(g));
+    g.rng.state = seed * 0x9E3779B97F4A7C15ULL + 1; // never 0
+    g.wide = options->wide;
+    g.quiet = options->quiet;
+    g.limit = options->wide ? INT64_MAX : 0x7FFF;
+    AsmBufferInit(&g.text, NULL);
+
+    AsmPutString(&g.text, ">>>\n");
+    for(int i = 0; i < options->variables && g.int_count < MAX_VARS; i++) {
+        long long value;
+        AsmPutString(&g.text, "int ");
+        PutName(&g, 'v', g.int_count);
+        AsmPutString(&g.text, " = ");
+        PutExpr(&g, &value);
+        AsmPutString(&g.text, "\n");
+        g.ints[g.int_count++] = value;
+    }
+    for(int i = 0; i < options->statements; i++) {
+        GenStatement(&g);
+    }
+    AsmPutString(&g.text, "<<<"); // nothing may follow the end delimiter, not even a newline
+    return AsmBufferDetach(&g.text, NULL);
+}
+
+// minimizer: the body lines of the program, each either kept or dropped
+typedef struct {
+    char **lines;
+    int *alive;
+    int count;
+} Program;
+
+static int IsKeyword(const char *word, size_t length) {
+    return (length == 1 && strncmp(word, "p", 1) == 0) || (length == 2 && strncmp(word, "ch", 2) == 0) ||
+           (length == 3 && strncmp(word, "int", 3) == 0);
+}
+
+// every variable is declared before a kept line uses it
+static int IsClosed(const Program *prog) {
+    const char *declared[2 * MAX_VARS * 4];
+    size_t declared_length[2 * MAX_VARS * 4];
+    int declared_count = 0;
+
+    for(int i = 0; i < prog->count; i++) {
+        if(!prog->alive[i])
+            continue;
+        const char *s = prog->lines[i];
+        const char *defines = NULL;
+        size_t defines_length = 0;
+        int word_index = 0;
+        while(*s) {
+            if(*s == '"') {
+                // skip the literal
+                for(s++; *s && *s != '"'; s++) {
+                    if(*s == '\\' && s[1])
+                        s++;
+                }
+                if(*s)
+                    s++;
+                continue;
+            }
+            if(!isalpha((unsigned char)*s)) {
+                s++;
+                continue;
+            }
+            const char *word = s;
+            while(isalnum((unsigned char)*s) || *s == '_')
+                s++;
+            size_t length = (size_t)(s - word);
+            int first_word_is_type = word_index == 1 && (strncmp(prog->lines[i], "int ", 4) == 0 ||
+                                                          strncmp(prog->lines[i], "ch ", 3) == 0);
+            word_index++;
+            if(IsKeyword(word, length))
+                continue;
+            if(first_word_is_type) {
+                defines = word;
+                defines_length = length;
+                continue;
+            }
+            int found = 0;
+            for(int d = 0; d < declared_count && !found; d++) {
+                found = declared_length[d] == length && strncmp(declared[d], word, length) == 0;
+            }
+            if(!found)
+                return 0;
+        }
+        if(defines && declared_count < (int)(sizeof(declared) / sizeof(declared[0]))) {
+            declared[declared_count] = defines;
+            declared_length[declared_count++] = defines_length;
+        }
+    }
+    return 1;
+}
+
+static char *BuildProgram(const Program *prog) {
+    AsmBuffer text;
+    AsmBufferInit(&text, NULL);
+    AsmPutString(&text, ">>>\n");
+    for(int i = 0; i < prog->count; i++) {
+        if(!prog->alive[i])
+            continue;
+        AsmPutString(&text, prog->lines[i]);
+        AsmPutString(&text, "\n");
+    }
+    AsmPutString(&text, "<<<");
+    return AsmBufferDetach(&text, NULL);
+}
+
+static int StillFails(const Program *prog, DiffPredicate fails, void *context) {
+    if(!IsClosed(prog))
+        return 0;
+    char *source = BuildProgram(prog);
+    int result = fails(context, source);
+    free(source);
+    return result;
+}
+
+// start of each top-level item of a "p: a, b, c" line; the number of items
+static int SplitPrintItems(const char *line, const char **starts, int max) {
+    if(strncmp(line, "p: ", 3) != 0)
+        return 0;
+    int count = 0;
+    const char *s = line + 3;
+    starts[count++] = s;
+    for(; *s; s++) {
+        if(*s == '"') {
+            for(s++; *s && *s != '"'; s++) {
+                if(*s == '\\' && s[1])
+                    s++;
+            }
+            if(!*s)
+                break;
+        } else if(*s == ',' && count < max) {
+            starts[count++] = s + 2; // items are separated by ", "
+        }
+    }
+    return count;
+}
+
+// the line without its item-th print item
+static char *WithoutPrintItem(const char *line, const char **starts, int count, int item) {
+    size_t length = strlen(line);
+    char *result = malloc(length + 1);
+    const char *cut_start = item == 0 ? starts[0] : starts[item] - 2;
+    const char *cut_end = item == 0 ? starts[1] : (item + 1 < count ? starts[item + 1] - 2 : line + length);
+    size_t head = (size_t)(cut_start - line);
+    memcpy(result, line, head);
+    strcpy(result + head, cut_end);
+    return result;
+}
+
+static int DropStatements(Program *prog, DiffPredicate fails, void *context) {
+    int changed = 0;
+    int alive = 0;
+    for(int i = 0; i < prog->count; i++) {
+        alive += prog->alive[i];
+    }
+    // halve the chunk size down to single lines, keeping every removal that still fails
+    for(int chunk = alive / 2 > 0 ? alive / 2 : 1; chunk >= 1; chunk /= 2) {
+        for(int start = 0; start < prog->count; start++) {
+            if(!prog->alive[start])
+                continue;
+            int dropped[64];
+            int dropped_count = 0;
+            for(int i = start; i < prog->count && dropped_count < chunk && dropped_count < 64; i++) {
+                if(prog->alive[i]) {
+                    prog->alive[i] = 0;
+                    dropped[dropped_count++] = i;
+                }
+            }
+            if(StillFails(prog, fails, context)) {
+                changed = 1;
+            } else {
+                for(int k = 0; k < dropped_count; k++) {
+                    prog->alive[dropped[k]] = 1;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+static int DropPrintItems(Program *prog, DiffPredicate fails, void *context) {
+    int changed = 0;
+    for(int i = 0; i < prog->count; i++) {
+        if(!prog->alive[i])
+            continue;
+        const char *starts[PRINT_ITEMS * 4];
+        int count = SplitPrintItems(prog->lines[i], starts, PRINT_ITEMS * 4);
+        for(int item = 0; count > 1 && item < count; item++) {
+            char *shorter = WithoutPrintItem(prog->lines[i], starts, count, item);
+            char *old = prog->lines[i];
+            prog->lines[i] = shorter;
+            if(StillFails(prog, fails, context)) {
+                free(old);
+                changed = 1;
+                count = SplitPrintItems(prog->lines[i], starts, PRINT_ITEMS * 4);
+                item = -1; // start over on the shorter line
+            } else {
+                prog->lines[i] = old;
+                free(shorter);
+            }
+        }
+    }
+    return changed;
+}
+
+char *DiffMinimize(const char *source, DiffPredicate fails, void *context) {
+    Program prog = { NULL, NULL, 0 };
+    int capacity = 0;
+
+    // body lines, without the >>> and <<< delimiters
+    const char *s = source;
+    while(*s) {
+        const char *end = strchr(s, '\n');
+        size_t length = end ? (size_t)(end - s) : strlen(s);
+        if(!(length == 3 && (strncmp(s, ">>>", 3) == 0 || strncmp(s, "<<<", 3) == 0)) && length > 0) {
+            if(prog.count >= capacity) {
+                capacity = capacity ? capacity * 2 : 32;
+                prog.lines = realloc(prog.lines, sizeof(char *) * capacity);
+                prog.alive = realloc(prog.alive, sizeof(int) * capacity);
+            }
+            prog.lines[prog.count] = malloc(length + 1);
+            memcpy(prog.lines[prog.count], s, length);
+            prog.lines[prog.count][length] = '\0';
+            prog.alive[prog.count++] = 1;
+        }
+        s = end ? end + 1 : s + length;
+    }
+
+    while(DropStatements(&prog, fails, context) | DropPrintItems(&prog, fails, context))
+        ;
+
+    char *result = BuildProgram(&prog);
+    for(int i = 0; i < prog.count; i++) {
+        free(prog.lines[i]);
+    }
+    free(prog.lines);
+    free(prog.alive);
+    return result;
+}
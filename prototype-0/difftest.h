@@ -0,0 +1,29 @@
+#ifndef DIFFTEST_H
+#define DIFFTEST_H
+
+#include <stdint.h>
+
+// random valid .p0 programs for comparing the interpreter with the generated code
+typedef struct {
+    int statements;  // lines between >>> and <<<
+    int wide;        // 0: every value (literal, intermediate, variable) fits a 16-bit immediate;
+                     // 1: literals of any width, values wrap at 64 bits
+    int quiet;       // print statements are rare (programs for timing rather than checking)
+    int variables;   // int declarations written before the statements
+} DiffGenOptions;
+
+#define DIFFTEST_STATEMENTS 24
+#define DIFFTEST_CROWDED_VARIABLES 72   // more variables than the target has registers
+#define DIFFTEST_CROWDED_EVERY 8        // one program in this many starts with them
+
+// the program for this seed (the same seed always gives the same program); caller frees
+char *DiffGenerateProgram(uint64_t seed, const DiffGenOptions *options);
+
+// 1 if the program still shows the problem
+typedef int (*DiffPredicate)(void *context, const char *source);
+
+// drop statements and print items while the program keeps failing; candidates that would use
+// an undeclared variable are never tried; caller frees
+char *DiffMinimize(const char *source, DiffPredicate fails, void *context);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "instruction.h"
+
+void InstructionListInit(InstructionList *list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->line = 0;
+}
+
+void InstructionListFree(InstructionList *list) {
+    for(int i = 0; i < list->count; i++) {
+        free(list->items[i].symbol);
+    }
+    free(list->items);
+    InstructionListInit(list);
+}
+
+// append an instruction; unused operands are passed as 0 / NULL
+Instruction *EmitInstruction(InstructionList *list, Opcode op, int rd, int rs, int rt, long long imm, const char *symbol) {
+    if(list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, sizeof(Instruction) * list->capacity);
+    }
+
+    Instruction *ins = &list->items[list->count++];
+    ins->op = op;
+    ins->rd = rd;
+    ins->rs = rs;
+    ins->rt = rt;
+    ins->imm = imm;
+    ins->symbol = symbol ? strdup(symbol) : NULL;
+    ins->line = list->line;
+    return ins;
+}
+
+// drop the INS_NOP slots left behind by optimization passes
+void CompactInstructionList(InstructionList *list) {
+    int kept = 0;
+    for(int i = 0; i < list->count; i++) {
+        if(list->items[i].op == INS_NOP) {
+            free(list->items[i].symbol);
+            continue;
+        }
+        list->items[kept++] = list->items[i];
+    }
+    list->count = kept;
+}
+
+int InstructionDef(const Instruction *ins) {
+    switch(ins->op) {
+        case INS_DADDIU:
+        case INS_LD:
+        case INS_LUI:
+        case INS_ORI:
+            return ins->rt;
+        case INS_DADDU:
+        case INS_DSUBU:
+        case INS_MFLO:
+        case INS_MFHI:
+        case INS_DSLL:
+        case INS_SLTU:
+            return ins->rd;
+        default:
+            return -1; // sd, dmult/ddiv (HI/LO only), syscall
+    }
+}
+
+int InstructionUses(const Instruction *ins, int regs[3]) {
+    switch(ins->op) {
+        case INS_DADDIU:
+        case INS_LD:
+        case INS_ORI:
+            regs[0] = ins->rs;
+            return 1;
+        case INS_DSLL:
+            regs[0] = ins->rt;
+            return 1;
+        case INS_DADDU:
+        case INS_DSUBU:
+        case INS_SLTU:
+        case INS_DMULT:
+        case INS_DDIV:
+            regs[0] = ins->rs;
+            regs[1] = ins->rt;
+            return 2;
+        case INS_SD:
+            regs[0] = ins->rt; // value
+            regs[1] = ins->rs; // base
+            return 2;
+        case INS_SYSCALL:
+            // r4 holds the syscall argument, r14 the printf parameter block
+            regs[0] = ins->imm == 5 ? 14 : 4;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// "mnemonic " with its length, indexed by opcode
+static const struct {
+    const char *text;
+    int length;
+} mnemonics[] = {
+    [INS_NOP]     = { "", 0 },
+    [INS_DADDIU]  = { "daddiu ", 7 },
+    [INS_DADDU]   = { "daddu ", 6 },
+    [INS_DSUBU]   = { "dsubu ", 6 },
+    [INS_DMULT]   = { "dmult ", 6 },
+    [INS_DDIV]    = { "ddiv ", 5 },
+    [INS_MFLO]    = { "mflo ", 5 },
+    [INS_MFHI]    = { "mfhi ", 5 },
+    [INS_LD]      = { "ld ", 3 },
+    [INS_SD]      = { "sd ", 3 },
+    [INS_SYSCALL] = { "syscall ", 8 },
+    [INS_LUI]     = { "lui ", 4 },
+    [INS_ORI]     = { "ori ", 4 },
+    [INS_DSLL]    = { "dsll ", 5 },
+    [INS_SLTU]    = { "sltu ", 5 },
+};
+
+static char *FormatSeparator(char *p) {
+    p[0] = ',';
+    p[1] = ' ';
+    return p + 2;
+}
+
+void WriteInstruction(const Instruction *ins, AsmBuffer *buf) {
+    if(ins->op == INS_NOP)
+        return;
+
+    // longest line: mnemonic, three registers or register + immediate, separators, label
+    char *p = AsmReserve(buf, 48 + (ins->symbol ? strlen(ins->symbol) : 0));
+    memcpy(p, mnemonics[ins->op].text, mnemonics[ins->op].length);
+    p += mnemonics[ins->op].length;
+
+    switch(ins->op) {
+        case INS_DADDIU:
+            p = FormatSeparator(FormatRegister(p, ins->rt));
+            p = FormatSeparator(FormatRegister(p, ins->rs));
+            if(ins->symbol) {
+                p = FormatString(p, ins->symbol);
+            } else {
+                *p++ = '#';
+                p = FormatInt(p, ins->imm);
+            }
+            break;
+        case INS_DADDU:
+        case INS_DSUBU:
+        case INS_SLTU:
+            p = FormatSeparator(FormatRegister(p, ins->rd));
+            p = FormatSeparator(FormatRegister(p, ins->rs));
+            p = FormatRegister(p, ins->rt);
+            break;
+        case INS_DMULT:
+        case INS_DDIV:
+            p = FormatSeparator(FormatRegister(p, ins->rs));
+            p = FormatRegister(p, ins->rt);
+            break;
+        case INS_MFLO:
+        case INS_MFHI:
+            p = FormatRegister(p, ins->rd);
+            break;
+        case INS_LD:
+        case INS_SD:
+            p = FormatSeparator(FormatRegister(p, ins->rt));
+            p = ins->symbol ? FormatString(p, ins->symbol) : FormatInt(p, ins->imm);
+            *p++ = '(';
+            p = FormatRegister(p, ins->rs);
+            *p++ = ')';
+            break;
+        case INS_SYSCALL:
+            p = FormatInt(p, ins->imm);
+            break;
+        case INS_LUI:
+            p = FormatSeparator(FormatRegister(p, ins->rt));
+            *p++ = '#';
+            p = FormatInt(p, ins->imm);
+            break;
+        case INS_ORI:
+            p = FormatSeparator(FormatRegister(p, ins->rt));
+            p = FormatSeparator(FormatRegister(p, ins->rs));
+            *p++ = '#';
+            p = FormatInt(p, ins->imm);
+            break;
+        case INS_DSLL:
+            p = FormatSeparator(FormatRegister(p, ins->rd));
+            p = FormatSeparator(FormatRegister(p, ins->rt));
+            *p++ = '#';
+            p = FormatInt(p, ins->imm);
+            break;
+        case INS_NOP:
+            break;
+    }
+
+    *p++ = '\n';
+    AsmCommit(buf, p);
+}
+
+void WriteInstructionList(const InstructionList *list, AsmBuffer *buf) {
+    for(int i = 0; i < list->count; i++) {
+        WriteInstruction(&list->items[i], buf);
+    }
+}
+
+void PrintInstruction(const Instruction *ins, FILE *out) {
+    AsmBuffer buf;
+    AsmBufferInit(&buf, out);
+    WriteInstruction(ins, &buf);
+    AsmBufferFree(&buf);
+}
+
+void PrintInstructionList(const InstructionList *list, FILE *out) {
+    AsmBuffer buf;
+    AsmBufferInit(&buf, out);
+    WriteInstructionList(list, &buf);
+    AsmBufferFree(&buf);
+}
@@ -0,0 +1,59 @@
+#ifndef INSTRUCTION_H
+#define INSTRUCTION_H
+
+#include <stdio.h>
+#include "asm_buffer.h"
+
+// MIPS64 instructions emitted by the code generator
+typedef enum {
+    INS_NOP = 0, // removed by an optimization pass
+    INS_DADDIU,  // daddiu rt, rs, #imm | daddiu rt, rs, label
+    INS_DADDU,   // daddu rd, rs, rt
+    INS_DSUBU,   // dsubu rd, rs, rt
+    INS_DMULT,   // dmult rs, rt
+    INS_DDIV,    // ddiv rs, rt
+    INS_MFLO,    // mflo rd
+    INS_MFHI,    // mfhi rd
+    INS_LD,      // ld rt, label(rs) | ld rt, imm(rs)
+    INS_SD,      // sd rt, label(rs) | sd rt, imm(rs)
+    INS_SYSCALL, // syscall imm
+    INS_LUI,     // lui rt, #imm (imm 0..0xFFFF, shifted up 16 and sign-extended from bit 31)
+    INS_ORI,     // ori rt, rs, #imm (imm zero-extended)
+    INS_DSLL,    // dsll rd, rt, #imm (shift amount 0..31)
+    INS_SLTU     // sltu rd, rs, rt (1 if rs < rt unsigned, else 0)
+} Opcode;
+
+// one instruction, operands named after the MIPS encoding fields
+typedef struct {
+    Opcode op;
+    int rd, rs, rt;
+    long long imm;
+    char *symbol; // label operand (daddiu/ld/sd), NULL if numeric
+    int line;     // source line it was generated for, 0 if none
+} Instruction;
+
+// growable list of instructions for the .code section
+typedef struct {
+    Instruction *items;
+    int count;
+    int capacity;
+    int line;     // stamped on the instructions EmitInstruction appends
+} InstructionList;
+
+void InstructionListInit(InstructionList *list);
+void InstructionListFree(InstructionList *list);
+Instruction *EmitInstruction(InstructionList *list, Opcode op, int rd, int rs, int rt, long long imm, const char *symbol);
+void CompactInstructionList(InstructionList *list);
+
+// register written by the instruction, or -1
+int InstructionDef(const Instruction *ins);
+// registers read by the instruction; returns how many were stored in regs
+int InstructionUses(const Instruction *ins, int regs[3]);
+
+// assembly text, one line per instruction (NOPs are skipped)
+void WriteInstruction(const Instruction *ins, AsmBuffer *buf);
+void WriteInstructionList(const InstructionList *list, AsmBuffer *buf);
+void PrintInstruction(const Instruction *ins, FILE *out);
+void PrintInstructionList(const InstructionList *list, FILE *out);
+
+#endif
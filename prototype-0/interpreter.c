@@ -3,75 +3,148 @@
 #include <string.h>
 #include <stdbool.h>
 #include "interpreter.h"
+#include "bytecode.h"
+#include "arith.h"
 
 #define NODE_PRINT_PART 7
 
+// a string value points at the literal in the AST, which outlives the run: assigning one
+// copies a pointer and a length, nothing is allocated or freed
 typedef struct Variable {
-    char *name;
     union {
-        int int_val;
-        char *str_val;
+        long long int_val;
+        const char *str_val;
     } value;
+    int str_len;
     bool is_string;
     bool initialized;
 } Variable;
 
+// one variable per slot, allocated once: a Variable* stays valid for the whole run
 struct InterpreterState {
     Variable *vars;
     int var_count;
-    int var_capacity;
     OutputCapture *output;
 };
 
-static Variable* find_variable(InterpreterState *state, const char *name) {
-    for(int i = 0; i < state->var_count; i++) {
-        if(strcmp(state->vars[i].name, name) == 0) {
-            return &state->vars[i];
-        }
-    }
-    return NULL;
+static Variable* variable_of(InterpreterState *state, Node *id) {
+    return &state->vars[id->slot];
 }
 
-static Variable* add_variable(InterpreterState *state, const char *name) {
-    if(state->var_count >= state->var_capacity) {
-        state->var_capacity = state->var_capacity ? state->var_capacity * 2 : 10;
-        state->vars = realloc(state->vars, sizeof(Variable) * state->var_capacity);
-    }
-    
-    Variable *var = &state->vars[state->var_count++];
-    var->name = strdup(name);
-    var->value.int_val = 0;
-    var->initialized = false;
-    var->is_string = false;
-    return var;
-}
-
-static InterpreterState* create_state() {
+static InterpreterState* create_state(int slot_count, OutputCapture *output) {
     InterpreterState *state = malloc(sizeof(InterpreterState));
-    state->var_capacity = 10;
-    state->var_count = 0;
-    state->vars = malloc(sizeof(Variable) * state->var_capacity);
-    state->output = malloc(sizeof(OutputCapture));
-    capture_init(state->output);
+    state->var_count = slot_count;
+    state->vars = calloc(slot_count ? slot_count : 1, sizeof(Variable));
+    state->output = output;
     return state;
 }
 
 static void free_state(InterpreterState *state) {
-    for(int i = 0; i < state->var_count; i++) {
-        free(state->vars[i].name);
-        if(state->vars[i].is_string && state->vars[i].initialized) {
-            free(state->vars[i].value.str_val);
+    free(state->vars);
+    free(state);
+}
+
+// ---- slot resolution ----
+
+// names by slot, and an open-addressing index of them (slot + 1, 0 is empty)
+typedef struct {
+    const char **names;
+    int count;
+    int capacity;
+    int *index;
+    int index_size;  // a power of two, kept at least twice count
+} SlotTable;
+
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u; // FNV-1a
+    for(; *name; name++) {
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    }
+    return h;
+}
+
+static void index_slot(SlotTable *t, int slot) {
+    unsigned mask = t->index_size - 1;
+    unsigned h = hash_name(t->names[slot]) & mask;
+    while(t->index[h])
+        h = (h + 1) & mask;
+    t->index[h] = slot + 1;
+}
+
+static int slot_for(SlotTable *t, const char *name) {
+    unsigned mask = t->index_size - 1;
+    for(unsigned h = hash_name(name) & mask; t->index[h]; h = (h + 1) & mask) {
+        if(strcmp(t->names[t->index[h] - 1], name) == 0)
+            return t->index[h] - 1;
+    }
+    if(t->count >= t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 16;
+        t->names = realloc(t->names, sizeof(char *) * t->capacity);
+    }
+    t->names[t->count] = name;
+    if((t->count + 1) * 2 > t->index_size) {
+        free(t->index);
+        t->index_size *= 2;
+        t->index = calloc(t->index_size, sizeof(int));
+        for(int i = 0; i < t->count; i++) {
+            index_slot(t, i);
         }
     }
-    free(state->vars);
-    if(state->output) {
-        capture_free(state->output);
-        free(state->output);
+    index_slot(t, t->count);
+    return t->count++;
+}
+
+static void resolve_id(SlotTable *t, Node *id) {
+    id->slot = slot_for(t, id->str_val);
+}
+
+static void resolve_expression(SlotTable *t, Node *node) {
+    if(!node)
+        return;
+    if(node->node_type == 2) {
+        resolve_id(t, node);
+    } else if(node->node_type == 3) {
+        resolve_expression(t, node->binop.left);
+        resolve_expression(t, node->binop.right);
     }
-    free(state);
 }
 
-static int get_int_value(Variable *var) {
+int resolve_slots(Node *program, const char ***names) {
+    SlotTable t = { NULL };
+    t.index_size = 64;
+    t.index = calloc(t.index_size, sizeof(int));
+
+    for(Node *statement = program; statement; statement = statement->next) {
+        switch(statement->node_type) {
+            case 4: // NODE_DECL
+            case 5: // NODE_ASSIGN
+                for(Node *item = statement->decl_assign.items; item; item = item->next) {
+                    if(item->node_type == NODE_STR_ASSIGN)
+                        resolve_id(&t, item->str_assign.id);
+                    else
+                        resolve_expression(&t, item);
+                }
+                break;
+            case 6: // NODE_PRINT
+                for(Node *part = statement->print_stmt.parts; part; part = part->print_part.part_next) {
+                    if(part->node_type == NODE_PRINT_PART)
+                        resolve_expression(&t, part->print_part.items);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    free(t.index);
+    if(names)
+        *names = t.names;
+    else
+        free(t.names);
+    return t.count;
+}
+
+static long long get_int_value(Variable *var) {
     if(!var || !var->initialized)
         return 0;
     if(var->is_string)
@@ -87,7 +160,7 @@ static const char* get_str_value(Variable *var) {
     return var->value.str_val ? var->value.str_val : "";
 }
 
-static int evaluate_expression(Node *node, InterpreterState *state) {
+static long long evaluate_expression(Node *node, InterpreterState *state) {
     if(!node) {
         return 0;
     }
@@ -98,23 +171,20 @@ static int evaluate_expression(Node *node, InterpreterState *state) {
             
         case 2: // NODE_ID
         {
-            Variable *var = find_variable(state, node->str_val);
-            if(!var) {
-                var = add_variable(state, node->str_val);
-            }
+            Variable *var = variable_of(state, node);
             return get_int_value(var);
         }
             
         case 3: // NODE_BINOP
         {
-            int left = evaluate_expression(node->binop.left, state);
-            int right = evaluate_expression(node->binop.right, state);
+            long long left = evaluate_expression(node->binop.left, state);
+            long long right = evaluate_expression(node->binop.right, state);
             
             switch(node->binop.op) {
-                case '+': return left + right;
-                case '-': return left - right;
-                case '*': return left * right;
-                case '/': return right != 0 ? left / right : 0;
+                case '+': return arith_add(left, right);
+                case '-': return arith_sub(left, right);
+                case '*': return arith_mul(left, right);
+                case '/': return arith_div(left, right);
                 case '=': return left;
                 default: return 0;
             }
@@ -141,12 +211,9 @@ static void execute_statement(Node *node, InterpreterState *state) {
                     Node *left = current->binop.left;
                     Node *right = current->binop.right;
                     
-                    Variable *var = find_variable(state, left->str_val);
-                    if(!var) {
-                        var = add_variable(state, left->str_val);
-                    }
+                    Variable *var = variable_of(state, left);
                     
-                    int value = evaluate_expression(right, state);
+                    long long value = evaluate_expression(right, state);
                     var->value.int_val = value;
                     var->initialized = true;
                     var->is_string = false;
@@ -156,21 +223,16 @@ static void execute_statement(Node *node, InterpreterState *state) {
                     Node *id_node = current->str_assign.id;
                     Node *str_node = current->str_assign.str;
                     
-                    Variable *var = find_variable(state, id_node->str_val);
-                    if(!var) {
-                        var = add_variable(state, id_node->str_val);
-                    }
+                    Variable *var = variable_of(state, id_node);
                     
-                    var->value.str_val = strdup(str_node->str_val);
+                    var->value.str_val = str_node->str_val;
+                    var->str_len = str_node->str_len;
                     var->initialized = true;
                     var->is_string = true;
                     
                 } else if(current->node_type == 2) {
                     // declaration without initialization
-                    Variable *var = find_variable(state, current->str_val);
-                    if(!var) {
-                        var = add_variable(state, current->str_val);
-                    }
+                    Variable *var = variable_of(state, current);
                     var->initialized = false;
                     var->value.int_val = 0;
                 }
@@ -189,12 +251,9 @@ static void execute_statement(Node *node, InterpreterState *state) {
                     Node *left = current->binop.left;
                     Node *right = current->binop.right;
                     
-                    Variable *var = find_variable(state, left->str_val);
-                    if(!var) {
-                        var = add_variable(state, left->str_val);
-                    }
+                    Variable *var = variable_of(state, left);
                     
-                    int value = evaluate_expression(right, state);
+                    long long value = evaluate_expression(right, state);
                     var->value.int_val = value;
                     var->initialized = true;
                     var->is_string = false;
@@ -204,17 +263,10 @@ static void execute_statement(Node *node, InterpreterState *state) {
                     Node *id_node = current->str_assign.id;
                     Node *str_node = current->str_assign.str;
                     
-                    Variable *var = find_variable(state, id_node->str_val);
-                    if(!var) {
-                        var = add_variable(state, id_node->str_val);
-                    }
-                
-                    // free old string if it exists
-                    if(var->is_string && var->initialized && var->value.str_val) {
-                        free(var->value.str_val);
-                    }
-                    
-                    var->value.str_val = strdup(str_node->str_val);
+                    Variable *var = variable_of(state, id_node);
+
+                    var->value.str_val = str_node->str_val;
+                    var->str_len = str_node->str_len;
                     var->initialized = true;
                     var->is_string = true;
                 }
@@ -244,21 +296,21 @@ static void execute_statement(Node *node, InterpreterState *state) {
                     Node *content = current->print_part.items;
                     
                     if(content->node_type == 1) {  // STR literal
-                        capture_printf(state->output, "%s", content->str_val);
+                        capture_append(state->output, content->str_val, content->str_len);
                     } else if(content->node_type == 2) {  // ID (variable)
-                        Variable *var = find_variable(state, content->str_val);
+                        Variable *var = variable_of(state, content);
                         if(var && var->initialized) {
                             if(var->is_string) {
-                                capture_printf(state->output, "%s", var->value.str_val);
+                                capture_append(state->output, var->value.str_val, var->str_len);
                             } else {
-                                capture_printf(state->output, "%d", var->value.int_val);
+                                capture_int(state->output, var->value.int_val);
                             }
                         } else {
-                            capture_printf(state->output, "0");
+                            capture_append(state->output, "0", 1);
                         }
                     } else {  // expression or NUM
-                        int value = evaluate_expression(content, state);
-                        capture_printf(state->output, "%d", value);
+                        long long value = evaluate_expression(content, state);
+                        capture_int(state->output, value);
                     }
                 }
                 current = current->print_part.part_next;
@@ -271,14 +323,14 @@ static void execute_statement(Node *node, InterpreterState *state) {
                 // check if last content is not a string literal & not a string var
                 if(last_content->node_type != 1) {  // not a STR literal
                     if(last_content->node_type == 2) {  // ID - check if it's a string var
-                        Variable *var = find_variable(state, last_content->str_val);
+                        Variable *var = variable_of(state, last_content);
                         if(!var || !var->is_string) {
                             // not a string variable (or doesn't exist): add newline
-                            capture_printf(state->output, "\n");
+                            capture_append(state->output, "\n", 1);
                         }
                     } else {
                         // expr or other non-string: add \n
-                        capture_printf(state->output, "\n");
+                        capture_append(state->output, "\n", 1);
                     }
                 }
             }
@@ -291,12 +343,23 @@ static void execute_statement(Node *node, InterpreterState *state) {
     }
 }
 
-char* interpret_program(Node *program) {
+void interpret_into(Node *program, OutputCapture *output) {
     if(!program) {
-        return strdup("");
+        return;
     }
-    
-    InterpreterState *state = create_state();
+
+    // compile once, then run without touching the AST
+    Bytecode *bytecode = bytecode_compile(program);
+    bytecode_run(bytecode, output);
+    bytecode_free(bytecode);
+}
+
+void interpret_tree_into(Node *program, OutputCapture *output) {
+    interpret_tree_resolved(program, resolve_slots(program, NULL), output);
+}
+
+void interpret_tree_resolved(Node *program, int slot_count, OutputCapture *output) {
+    InterpreterState *state = create_state(slot_count, output);
 
     // execute all statements
     Node *current = program;
@@ -304,11 +367,25 @@ char* interpret_program(Node *program) {
         execute_statement(current, state);
         current = current->next;
     }
-    
-    char *output = capture_get(state->output);
-    char *result = strdup(output ? output : "");
-    
+
     free_state(state);
-    
+}
+
+// run one engine into memory and hand the text over
+static char* interpret_to_string(Node *program, void (*engine)(Node *, OutputCapture *)) {
+    OutputCapture output;
+    capture_init(&output);
+    engine(program, &output);
+    char *result = output.buffer; // NUL-terminated, owned by the caller from here on
+    output.buffer = NULL;
+    capture_free(&output);
     return result;
-}
\ No newline at end of file
+}
+
+char* interpret_program(Node *program) {
+    return interpret_to_string(program, interpret_into);
+}
+
+char* interpret_program_tree(Node *program) {
+    return interpret_to_string(program, interpret_tree_into);
+}
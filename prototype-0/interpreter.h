@@ -6,6 +6,21 @@
 
 typedef struct InterpreterState InterpreterState;
 
+// pre-pass of both engines: numbers the program's variables in order of first use and stores
+// each ID node's number in node->slot; returns how many there are, and their names by slot
+// in *names (pointing into the AST; caller frees the array) unless names is NULL
+int resolve_slots(Node *program, const char ***names);
+
+// run the program on the bytecode VM, appending its output to output as it is produced
+// (give the capture a sink to stream it)
+void interpret_into(Node *program, OutputCapture *output);
+// same output from walking the AST statement by statement (the reference for the VM)
+void interpret_tree_into(Node *program, OutputCapture *output);
+// the tree walker on a program resolve_slots has already numbered (slot_count slots)
+void interpret_tree_resolved(Node *program, int slot_count, OutputCapture *output);
+
+// the whole output as one string; caller frees
 char* interpret_program(Node *program);
+char* interpret_program_tree(Node *program);
 
 #endif
\ No newline at end of file
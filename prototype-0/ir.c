@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+// per-opcode properties: printed name, result type, number of vreg operands
+static const struct {
+    const char *name;
+    IrType result;
+    int operands;
+} op_info[IR_OP_COUNT] = {
+    [IR_CONST]      = { "const",      IR_TYPE_INT,  0 },
+    [IR_ADDR]       = { "addr",       IR_TYPE_ADDR, 0 },
+    [IR_LOAD]       = { "load",       IR_TYPE_INT,  0 },
+    [IR_STORE]      = { "store",      IR_TYPE_VOID, 1 },
+    [IR_ADD]        = { "add",        IR_TYPE_INT,  2 },
+    [IR_SUB]        = { "sub",        IR_TYPE_INT,  2 },
+    [IR_MUL]        = { "mul",        IR_TYPE_INT,  2 },
+    [IR_DIV]        = { "div",        IR_TYPE_INT,  2 },
+    [IR_PRINT_INT]  = { "print_int",  IR_TYPE_VOID, 1 },
+    [IR_PRINT_STR]  = { "print_str",  IR_TYPE_VOID, 1 },
+    [IR_PRINT_CHAR] = { "print_char", IR_TYPE_VOID, 1 },
+    [IR_PRINT_ARG]  = { "print_arg",  IR_TYPE_VOID, 1 },
+    [IR_PRINTF]     = { "printf",     IR_TYPE_VOID, 0 },
+    [IR_EXIT]       = { "exit",       IR_TYPE_VOID, 0 },
+};
+
+void IrInit(IrProgram *ir) {
+    ir->blocks = NULL;
+    ir->block_count = 0;
+    ir->block_capacity = 0;
+    ir->vreg_types = NULL;
+    ir->vreg_count = 0;
+    ir->vreg_capacity = 0;
+    ir->line = 0;
+}
+
+void IrFree(IrProgram *ir) {
+    for(int i = 0; i < ir->block_count; i++) {
+        IrBlock *block = &ir->blocks[i];
+        for(int j = 0; j < block->count; j++) {
+            free(block->instrs[j].symbol);
+        }
+        free(block->instrs);
+    }
+    free(ir->blocks);
+    free(ir->vreg_types);
+    IrInit(ir);
+}
+
+const char *IrOpName(IrOp op) {
+    return (op >= 0 && op < IR_OP_COUNT) ? op_info[op].name : "?";
+}
+
+IrType IrResultType(IrOp op) {
+    return (op >= 0 && op < IR_OP_COUNT) ? op_info[op].result : IR_TYPE_VOID;
+}
+
+int IrOperandCount(IrOp op) {
+    return (op >= 0 && op < IR_OP_COUNT) ? op_info[op].operands : 0;
+}
+
+int IrInstrCount(const IrProgram *ir) {
+    int total = 0;
+    for(int i = 0; i < ir->block_count; i++) {
+        total += ir->blocks[i].count;
+    }
+    return total;
+}
+
+IrBlock *IrNewBlock(IrProgram *ir) {
+    if(ir->block_count >= ir->block_capacity) {
+        ir->block_capacity = ir->block_capacity ? ir->block_capacity * 2 : 4;
+        ir->blocks = realloc(ir->blocks, sizeof(IrBlock) * ir->block_capacity);
+    }
+    IrBlock *block = &ir->blocks[ir->block_count];
+    block->id = ir->block_count++;
+    block->instrs = NULL;
+    block->count = 0;
+    block->capacity = 0;
+    return block;
+}
+
+int IrNewVreg(IrProgram *ir, IrType type) {
+    // vreg 0 means "none", so numbering starts at 1
+    if(ir->vreg_count + 1 >= ir->vreg_capacity) {
+        ir->vreg_capacity = ir->vreg_capacity ? ir->vreg_capacity * 2 : 64;
+        ir->vreg_types = realloc(ir->vreg_types, sizeof(IrType) * ir->vreg_capacity);
+    }
+    int v = ++ir->vreg_count;
+    ir->vreg_types[v] = type;
+    return v;
+}
+
+int IrEmit(IrProgram *ir, IrOp op, int a, int b, long long imm, const char *symbol) {
+    if(ir->block_count == 0)
+        IrNewBlock(ir);
+
+    IrBlock *block = &ir->blocks[ir->block_count - 1];
+    if(block->count >= block->capacity) {
+        block->capacity = block->capacity ? block->capacity * 2 : 64;
+        block->instrs = realloc(block->instrs, sizeof(IrInstr) * block->capacity);
+    }
+
+    IrInstr *ins = &block->instrs[block->count++];
+    ins->op = op;
+    ins->a = a;
+    ins->b = b;
+    ins->imm = imm;
+    ins->symbol = symbol ? strdup(symbol) : NULL;
+    ins->line = ir->line;
+    ins->dst = 0;
+    if(IrResultType(op) != IR_TYPE_VOID)
+        ins->dst = IrNewVreg(ir, IrResultType(op));
+    return ins->dst;
+}
+
+int IrEmitLoadAddress(IrProgram *ir, const char *symbol) {
+    int dst = IrEmit(ir, IR_LOAD, 0, 0, 0, symbol);
+    ir->vreg_types[dst] = IR_TYPE_ADDR;
+    return dst;
+}
+
+static const char *TypeName(IrType type) {
+    switch(type) {
+        case IR_TYPE_INT: return "int";
+        case IR_TYPE_ADDR: return "addr";
+        default: return "void";
+    }
+}
+
+// e.g.  v3:int = add v1, v2   |   store x, v3   |   v4:addr = addr str0
+void IrDump(const IrProgram *ir, FILE *out) {
+    for(int i = 0; i < ir->block_count; i++) {
+        const IrBlock *block = &ir->blocks[i];
+        fprintf(out, "bb%d:\n", block->id);
+        for(int j = 0; j < block->count; j++) {
+            const IrInstr *ins = &block->instrs[j];
+            fprintf(out, "  ");
+            if(ins->dst)
+                fprintf(out, "v%d:%s = ", ins->dst, TypeName(ir->vreg_types[ins->dst]));
+            fprintf(out, "%s", IrOpName(ins->op));
+
+            const char *sep = " ";
+            if(ins->op == IR_CONST || ins->op == IR_PRINT_ARG) {
+                fprintf(out, "%s%lld", sep, ins->imm);
+                sep = ", ";
+            }
+            if(ins->symbol) {
+                fprintf(out, "%s%s", sep, ins->symbol);
+                sep = ", ";
+            }
+            int n = IrOperandCount(ins->op);
+            if(n >= 1) {
+                fprintf(out, "%sv%d", sep, ins->a);
+                sep = ", ";
+            }
+            if(n >= 2)
+                fprintf(out, "%sv%d", sep, ins->b);
+            fprintf(out, "\n");
+        }
+    }
+    fprintf(out, "; %d blocks, %d instructions, %d vregs\n",
+            ir->block_count, IrInstrCount(ir), ir->vreg_count);
+}
+
+// operand must be a vreg defined earlier with the expected type
+static int VerifyOperand(const IrProgram *ir, const char *defined, int v, IrType expected,
+                         const IrBlock *block, int index, FILE *err) {
+    if(v <= 0 || v > ir->vreg_count) {
+        fprintf(err, "IR error: bb%d[%d] %s uses invalid vreg v%d\n",
+                block->id, index, IrOpName(block->instrs[index].op), v);
+        return 1;
+    }
+    if(!defined[v]) {
+        fprintf(err, "IR error: bb%d[%d] %s uses v%d before its definition\n",
+                block->id, index, IrOpName(block->instrs[index].op), v);
+        return 1;
+    }
+    if(ir->vreg_types[v] != expected) {
+        fprintf(err, "IR error: bb%d[%d] %s expects %s operand, v%d is %s\n",
+                block->id, index, IrOpName(block->instrs[index].op),
+                TypeName(expected), v, TypeName(ir->vreg_types[v]));
+        return 1;
+    }
+    return 0;
+}
+
+int IrVerify(const IrProgram *ir, FILE *err) {
+    int errors = 0;
+    char *defined = calloc(ir->vreg_count + 1, 1);
+    int exited = 0;
+
+    for(int i = 0; i < ir->block_count; i++) {
+        const IrBlock *block = &ir->blocks[i];
+        for(int j = 0; j < block->count; j++) {
+            const IrInstr *ins = &block->instrs[j];
+
+            if(ins->op < 0 || ins->op >= IR_OP_COUNT) {
+                fprintf(err, "IR error: bb%d[%d] unknown opcode %d\n", block->id, j, ins->op);
+                errors++;
+                continue;
+            }
+            if(exited) {
+                fprintf(err, "IR error: bb%d[%d] %s after exit\n", block->id, j, IrOpName(ins->op));
+                errors++;
+            }
+
+            // operand types
+            switch(ins->op) {
+                case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+                    errors += VerifyOperand(ir, defined, ins->a, IR_TYPE_INT, block, j, err);
+                    errors += VerifyOperand(ir, defined, ins->b, IR_TYPE_INT, block, j, err);
+                    break;
+                case IR_PRINT_INT: case IR_PRINT_CHAR:
+                    errors += VerifyOperand(ir, defined, ins->a, IR_TYPE_INT, block, j, err);
+                    break;
+                case IR_PRINT_STR:
+                    errors += VerifyOperand(ir, defined, ins->a, IR_TYPE_ADDR, block, j, err);
+                    break;
+                case IR_STORE:
+                case IR_PRINT_ARG: {
+                    // an int or an address (for %s, or a ch variable)
+                    IrType expected = IR_TYPE_INT;
+                    if(ins->a > 0 && ins->a <= ir->vreg_count && ir->vreg_types[ins->a] == IR_TYPE_ADDR)
+                        expected = IR_TYPE_ADDR;
+                    errors += VerifyOperand(ir, defined, ins->a, expected, block, j, err);
+                    if(ins->op == IR_PRINT_ARG && ins->imm < 1) {
+                        fprintf(err, "IR error: bb%d[%d] print_arg writes word %lld of the parameter block\n",
+                                block->id, j, ins->imm);
+                        errors++;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            if((ins->op == IR_ADDR || ins->op == IR_LOAD || ins->op == IR_STORE || ins->op == IR_PRINTF) && !ins->symbol) {
+                fprintf(err, "IR error: bb%d[%d] %s without a symbol\n", block->id, j, IrOpName(ins->op));
+                errors++;
+            }
+
+            // single definition of a vreg with the op's result type
+            if(IrResultType(ins->op) != IR_TYPE_VOID) {
+                if(ins->dst <= 0 || ins->dst > ir->vreg_count) {
+                    fprintf(err, "IR error: bb%d[%d] %s has no valid destination\n",
+                            block->id, j, IrOpName(ins->op));
+                    errors++;
+                } else if(defined[ins->dst]) {
+                    fprintf(err, "IR error: bb%d[%d] v%d defined twice\n", block->id, j, ins->dst);
+                    errors++;
+                } else {
+                    defined[ins->dst] = 1;
+                    // variables hold ints, or addresses for ch variables
+                    int load_address = ins->op == IR_LOAD && ir->vreg_types[ins->dst] == IR_TYPE_ADDR;
+                    if(ir->vreg_types[ins->dst] != IrResultType(ins->op) && !load_address) {
+                        fprintf(err, "IR error: bb%d[%d] v%d has type %s, %s produces %s\n",
+                                block->id, j, ins->dst, TypeName(ir->vreg_types[ins->dst]),
+                                IrOpName(ins->op), TypeName(IrResultType(ins->op)));
+                        errors++;
+                    }
+                }
+            } else if(ins->dst != 0) {
+                fprintf(err, "IR error: bb%d[%d] %s cannot define v%d\n",
+                        block->id, j, IrOpName(ins->op), ins->dst);
+                errors++;
+            }
+
+            if(ins->op == IR_EXIT)
+                exited = 1;
+        }
+    }
+
+    if(!exited) {
+        fprintf(err, "IR error: program does not end with exit\n");
+        errors++;
+    }
+
+    free(defined);
+    return errors;
+}
@@ -0,0 +1,82 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+
+// three-address intermediate representation between the AST and MIPS64
+// every value lives in a virtual register (v1, v2, ...) that is defined once
+
+typedef enum {
+    IR_TYPE_VOID = 0, // no value (stores, prints, exit)
+    IR_TYPE_INT,      // 64-bit integer
+    IR_TYPE_ADDR      // address of a data label (strings)
+} IrType;
+
+typedef enum {
+    IR_CONST = 0,   // dst = imm
+    IR_ADDR,        // dst = &symbol
+    IR_LOAD,        // dst = [symbol] (an int, or an addr for ch variables)
+    IR_STORE,       // [symbol] = a (int or addr)
+    IR_ADD,         // dst = a + b
+    IR_SUB,         // dst = a - b
+    IR_MUL,         // dst = a * b
+    IR_DIV,         // dst = a / b
+    IR_PRINT_INT,   // print integer a
+    IR_PRINT_STR,   // print string at address a
+    IR_PRINT_CHAR,  // print character a
+    IR_PRINT_ARG,   // word imm of the printf parameter block = a
+    IR_PRINTF,      // print with format string symbol and the stored parameters
+    IR_EXIT,        // end of program
+    IR_OP_COUNT
+} IrOp;
+
+typedef struct {
+    IrOp op;
+    int dst;        // defined vreg, 0 if none
+    int a, b;       // operand vregs, 0 if unused
+    long long imm;
+    char *symbol;   // data label for addr/load/store/printf
+    int line;       // source line of the statement it was lowered from, 0 if none
+} IrInstr;
+
+typedef struct {
+    int id;
+    IrInstr *instrs;
+    int count;
+    int capacity;
+} IrBlock;
+
+typedef struct {
+    IrBlock *blocks;
+    int block_count;
+    int block_capacity;
+    IrType *vreg_types; // indexed by vreg number, [0] unused
+    int vreg_count;
+    int vreg_capacity;
+    int line;           // stamped on the instructions IrEmit appends
+} IrProgram;
+
+void IrInit(IrProgram *ir);
+void IrFree(IrProgram *ir);
+
+// start a new basic block; following IrEmit calls append to it
+IrBlock *IrNewBlock(IrProgram *ir);
+
+// fresh vreg of the given type, for passes that build instructions by hand
+int IrNewVreg(IrProgram *ir, IrType type);
+
+// append to the current block; returns the new dst vreg (0 for ops without a result)
+int IrEmit(IrProgram *ir, IrOp op, int a, int b, long long imm, const char *symbol);
+// load of a variable that holds an address (a ch variable) rather than an int
+int IrEmitLoadAddress(IrProgram *ir, const char *symbol);
+
+const char *IrOpName(IrOp op);
+IrType IrResultType(IrOp op);
+int IrOperandCount(IrOp op);
+int IrInstrCount(const IrProgram *ir);
+
+void IrDump(const IrProgram *ir, FILE *out);
+// returns the number of problems found; each one is reported to err
+int IrVerify(const IrProgram *ir, FILE *err);
+
+#endif
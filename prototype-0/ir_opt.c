@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ir_opt.h"
+
+// programs are straight-line code: every block has the one before it as its only
+// predecessor, so SSA construction needs no phis and walking the blocks in order
+// visits every definition before its uses
+
+// hash table from an expression (op, operands, imm, symbol) to the vreg computing it
+typedef struct {
+    int used;
+    IrOp op;
+    int a, b;
+    long long imm;
+    const char *symbol;
+    int value;
+} ValueEntry;
+
+typedef struct {
+    ValueEntry *entries;
+    int capacity; // power of two
+    int count;
+} ValueTable;
+
+static void TableInit(ValueTable *t, int expected) {
+    t->capacity = 64;
+    while(t->capacity < expected * 2)
+        t->capacity *= 2;
+    t->entries = calloc(t->capacity, sizeof(ValueEntry));
+    t->count = 0;
+}
+
+static void TableFree(ValueTable *t) {
+    free(t->entries);
+    t->entries = NULL;
+    t->capacity = t->count = 0;
+}
+
+static uint64_t HashKey(IrOp op, int a, int b, long long imm, const char *symbol) {
+    uint64_t h = 1469598103934665603ULL;
+    h = (h ^ (uint64_t)op) * 1099511628211ULL;
+    h = (h ^ (uint64_t)a) * 1099511628211ULL;
+    h = (h ^ (uint64_t)b) * 1099511628211ULL;
+    h = (h ^ (uint64_t)imm) * 1099511628211ULL;
+    if(symbol) {
+        for(const char *p = symbol; *p; p++)
+            h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static int SameKey(const ValueEntry *e, IrOp op, int a, int b, long long imm, const char *symbol) {
+    if(e->op != op || e->a != a || e->b != b || e->imm != imm)
+        return 0;
+    if(!e->symbol || !symbol)
+        return e->symbol == symbol;
+    return strcmp(e->symbol, symbol) == 0;
+}
+
+static ValueEntry *TableSlot(ValueTable *t, IrOp op, int a, int b, long long imm, const char *symbol) {
+    uint64_t mask = t->capacity - 1;
+    uint64_t i = HashKey(op, a, b, imm, symbol) & mask;
+    while(t->entries[i].used && !SameKey(&t->entries[i], op, a, b, imm, symbol))
+        i = (i + 1) & mask;
+    return &t->entries[i];
+}
+
+static void TableGrow(ValueTable *t) {
+    ValueEntry *old = t->entries;
+    int old_capacity = t->capacity;
+    t->capacity *= 2;
+    t->entries = calloc(t->capacity, sizeof(ValueEntry));
+    for(int i = 0; i < old_capacity; i++) {
+        if(old[i].used) {
+            ValueEntry *e = TableSlot(t, old[i].op, old[i].a, old[i].b, old[i].imm, old[i].symbol);
+            *e = old[i];
+        }
+    }
+    free(old);
+}
+
+// existing value for the key, or 0
+static int TableFind(ValueTable *t, IrOp op, int a, int b, long long imm, const char *symbol) {
+    ValueEntry *e = TableSlot(t, op, a, b, imm, symbol);
+    return e->used ? e->value : 0;
+}
+
+static void TableSet(ValueTable *t, IrOp op, int a, int b, long long imm, const char *symbol, int value) {
+    if((t->count + 1) * 2 > t->capacity)
+        TableGrow(t);
+    ValueEntry *e = TableSlot(t, op, a, b, imm, symbol);
+    if(!e->used) {
+        e->used = 1;
+        e->op = op;
+        e->a = a;
+        e->b = b;
+        e->imm = imm;
+        e->symbol = symbol;
+        t->count++;
+    }
+    e->value = value;
+}
+
+// vreg -> vreg it was replaced by
+static int Resolve(int *repl, int v) {
+    while(v && repl[v] != v)
+        v = repl[v] = repl[repl[v]];
+    return v;
+}
+
+static int IsPure(IrOp op) {
+    switch(op) {
+        case IR_CONST: case IR_ADDR: case IR_LOAD:
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// evaluate with the target's 64-bit wrap-around; returns 0 if it cannot be folded
+static int FoldBinary(IrOp op, long long x, long long y, long long *result) {
+    uint64_t ux = (uint64_t)x, uy = (uint64_t)y;
+    switch(op) {
+        case IR_ADD: *result = (long long)(ux + uy); return 1;
+        case IR_SUB: *result = (long long)(ux - uy); return 1;
+        case IR_MUL: *result = (long long)(ux * uy); return 1;
+        case IR_DIV:
+            if(y == 0 || (x == INT64_MIN && y == -1))
+                return 0; // left to the hardware
+            *result = x / y;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void MakeConst(IrInstr *ins, long long value) {
+    ins->op = IR_CONST;
+    ins->a = ins->b = 0;
+    ins->imm = value;
+}
+
+void IrOptimize(IrProgram *ir, IrOptStats *stats) {
+    IrOptStats local;
+    if(!stats)
+        stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    stats->instrs_before = IrInstrCount(ir);
+
+    int n = stats->instrs_before;
+    int vregs = ir->vreg_count;
+    int *repl = malloc(sizeof(int) * (vregs + 1));
+    char *is_const = calloc(vregs + 1, 1);
+    long long *const_val = calloc(vregs + 1, sizeof(long long));
+    for(int v = 0; v <= vregs; v++)
+        repl[v] = v;
+
+    ValueTable values;   // expression -> vreg (global value numbering)
+    ValueTable defs;     // variable -> vreg of its current SSA value
+    TableInit(&values, n);
+    TableInit(&defs, 64);
+
+    for(int bi = 0; bi < ir->block_count; bi++) {
+        IrBlock *block = &ir->blocks[bi];
+        for(int j = 0; j < block->count; j++) {
+            IrInstr *ins = &block->instrs[j];
+            int operands = IrOperandCount(ins->op);
+            if(operands >= 1) ins->a = Resolve(repl, ins->a);
+            if(operands >= 2) ins->b = Resolve(repl, ins->b);
+
+            switch(ins->op) {
+                case IR_LOAD: {
+                    // SSA renaming: a load sees the value of the last store (or earlier load)
+                    int current = TableFind(&defs, IR_LOAD, 0, 0, 0, ins->symbol);
+                    if(current) {
+                        repl[ins->dst] = current;
+                        stats->loads_forwarded++;
+                        continue;
+                    }
+                    TableSet(&defs, IR_LOAD, 0, 0, 0, ins->symbol, ins->dst);
+                    continue;
+                }
+                case IR_STORE:
+                    TableSet(&defs, IR_LOAD, 0, 0, 0, ins->symbol, ins->a);
+                    continue;
+                case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: {
+                    int a = ins->a, b = ins->b;
+                    long long folded;
+                    if(is_const[a] && is_const[b] && FoldBinary(ins->op, const_val[a], const_val[b], &folded)) {
+                        MakeConst(ins, folded);
+                        stats->constants_folded++;
+                        break;
+                    }
+                    // algebraic identities
+                    int same = 0;
+                    if((ins->op == IR_ADD || ins->op == IR_SUB) && is_const[b] && const_val[b] == 0)
+                        same = a;
+                    else if(ins->op == IR_ADD && is_const[a] && const_val[a] == 0)
+                        same = b;
+                    else if((ins->op == IR_MUL || ins->op == IR_DIV) && is_const[b] && const_val[b] == 1)
+                        same = a;
+                    else if(ins->op == IR_MUL && is_const[a] && const_val[a] == 1)
+                        same = b;
+                    if(same) {
+                        repl[ins->dst] = same;
+                        stats->constants_folded++;
+                        continue;
+                    }
+                    if((ins->op == IR_MUL && ((is_const[a] && const_val[a] == 0) || (is_const[b] && const_val[b] == 0))) ||
+                       (ins->op == IR_SUB && a == b)) {
+                        MakeConst(ins, 0);
+                        stats->constants_folded++;
+                        break;
+                    }
+                    // canonical operand order for commutative ops
+                    if((ins->op == IR_ADD || ins->op == IR_MUL) && ins->a > ins->b) {
+                        ins->a = b;
+                        ins->b = a;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            if(!IsPure(ins->op))
+                continue;
+
+            // global value numbering
+            int existing = TableFind(&values, ins->op, ins->a, ins->b, ins->imm, ins->symbol);
+            if(existing) {
+                repl[ins->dst] = existing;
+                stats->values_numbered++;
+                continue;
+            }
+            TableSet(&values, ins->op, ins->a, ins->b, ins->imm, ins->symbol, ins->dst);
+            if(ins->op == IR_CONST) {
+                is_const[ins->dst] = 1;
+                const_val[ins->dst] = ins->imm;
+            }
+        }
+    }
+
+    // sweep backwards: drop replaced instructions, stores that a later store overwrites
+    // (every load after a store was renamed above), and values nobody reads
+    int *uses = calloc(vregs + 1, sizeof(int));
+    ValueTable stored;
+    TableInit(&stored, 64);
+
+    for(int bi = ir->block_count - 1; bi >= 0; bi--) {
+        IrBlock *block = &ir->blocks[bi];
+        int kept = block->count;
+        for(int j = block->count - 1; j >= 0; j--) {
+            IrInstr *ins = &block->instrs[j];
+            int operands = IrOperandCount(ins->op);
+            int dead = 0;
+
+            if(ins->dst && repl[ins->dst] != ins->dst) {
+                dead = 1; // replaced by an equal value
+            } else if(ins->op == IR_STORE) {
+                if(TableFind(&stored, IR_STORE, 0, 0, 0, ins->symbol)) {
+                    dead = 1;
+                    stats->dead_stores++;
+                } else {
+                    TableSet(&stored, IR_STORE, 0, 0, 0, ins->symbol, 1);
+                }
+            } else if(IsPure(ins->op) && uses[ins->dst] == 0) {
+                dead = 1;
+                stats->dead_instrs++;
+            }
+
+            if(dead) {
+                free(ins->symbol);
+                continue;
+            }
+
+            if(operands >= 1) {
+                ins->a = Resolve(repl, ins->a);
+                uses[ins->a]++;
+            }
+            if(operands >= 2) {
+                ins->b = Resolve(repl, ins->b);
+                uses[ins->b]++;
+            }
+            block->instrs[--kept] = *ins;
+        }
+
+        // kept instructions were packed at the end of the array
+        memmove(block->instrs, block->instrs + kept, sizeof(IrInstr) * (block->count - kept));
+        block->count -= kept;
+    }
+
+    stats->instrs_after = IrInstrCount(ir);
+
+    TableFree(&stored);
+    TableFree(&values);
+    TableFree(&defs);
+    free(uses);
+    free(const_val);
+    free(is_const);
+    free(repl);
+}
+
+// growable text for the merged literal and format string
+typedef struct {
+    char *data;
+    int length;
+    int capacity;
+} TextBuffer;
+
+static void TextAppend(TextBuffer *t, const char *text) {
+    int n = strlen(text);
+    if(t->length + n + 1 > t->capacity) {
+        while(t->length + n + 1 > t->capacity)
+            t->capacity = t->capacity ? t->capacity * 2 : 64;
+        t->data = realloc(t->data, t->capacity);
+    }
+    memcpy(t->data + t->length, text, n + 1);
+    t->length += n;
+}
+
+static int IsPrint(IrOp op) {
+    return op == IR_PRINT_INT || op == IR_PRINT_STR || op == IR_PRINT_CHAR;
+}
+
+// text of a print whose operand is known at compile time, NULL otherwise
+static const char *PrintText(const IrInstr *ins, const IrInstr *defs, const IrStringPool *pool,
+                             char *buf, size_t size) {
+    const IrInstr *def = &defs[ins->a];
+    switch(ins->op) {
+        case IR_PRINT_INT:
+            if(def->op != IR_CONST)
+                return NULL;
+            snprintf(buf, size, "%lld", def->imm);
+            return buf;
+        case IR_PRINT_CHAR:
+            if(def->op != IR_CONST || (char)def->imm == '\0')
+                return NULL;
+            buf[0] = (char)def->imm;
+            buf[1] = '\0';
+            return buf;
+        case IR_PRINT_STR:
+            return def->op == IR_ADDR ? pool->text_of(def->symbol) : NULL;
+        default:
+            return NULL;
+    }
+}
+
+void IrMergePrints(IrProgram *ir, const IrStringPool *pool, IrOptStats *stats) {
+    // definition of every vreg, to tell which print operands are constants
+    IrInstr *defs = calloc(ir->vreg_count + 1, sizeof(IrInstr));
+    for(int v = 0; v <= ir->vreg_count; v++)
+        defs[v].op = IR_OP_COUNT;
+    for(int bi = 0; bi < ir->block_count; bi++) {
+        for(int j = 0; j < ir->blocks[bi].count; j++) {
+            const IrInstr *ins = &ir->blocks[bi].instrs[j];
+            if(ins->dst)
+                defs[ins->dst] = *ins;
+        }
+    }
+
+    TextBuffer plain = { NULL, 0, 0 };  // output of the run
+    TextBuffer format = { NULL, 0, 0 }; // same with %d / %s for run-time values
+    char buf[32];
+
+    for(int bi = 0; bi < ir->block_count; bi++) {
+        IrBlock *block = &ir->blocks[bi];
+        // a merged run of two or more prints adds at most two instructions
+        IrInstr *out = malloc(sizeof(IrInstr) * (2 * block->count + 2));
+        int n = 0;
+
+        int i = 0;
+        while(i < block->count) {
+            IrInstr *ins = &block->instrs[i];
+            if(!IsPrint(ins->op)) {
+                out[n++] = *ins;
+                i++;
+                continue;
+            }
+
+            // the run ends at exit, at a print printf cannot express, or at the end of the block;
+            // other instructions in between do not print, so the prints can wait for them
+            plain.length = format.length = 0;
+            TextAppend(&plain, "");
+            TextAppend(&format, "");
+            int prints = 0, args = 0;
+            int end;
+            for(end = i; end < block->count; end++) {
+                const IrInstr *cur = &block->instrs[end];
+                if(cur->op == IR_EXIT)
+                    break;
+                if(!IsPrint(cur->op))
+                    continue;
+                const char *text = PrintText(cur, defs, pool, buf, sizeof(buf));
+                if(text) {
+                    TextAppend(&plain, text);
+                    for(const char *p = text; *p; p++) {
+                        char c[2] = { *p, '\0' };
+                        TextAppend(&format, *p == '%' ? "%%" : c);
+                    }
+                } else if(cur->op == IR_PRINT_CHAR) {
+                    break;
+                } else {
+                    TextAppend(&format, cur->op == IR_PRINT_INT ? "%d" : "%s");
+                    args++;
+                }
+                prints++;
+            }
+
+            const char *label = NULL;
+            if(prints >= 2)
+                label = pool->label_for(args ? format.data : plain.data);
+            if(!label) {
+                out[n++] = *ins;
+                i++;
+                continue;
+            }
+
+            int slot = 0;
+            int run_line = ins->line;
+            for(; i < end; i++) {
+                IrInstr cur = block->instrs[i];
+                if(IsPrint(cur.op)) {
+                    if(PrintText(&cur, defs, pool, buf, sizeof(buf)))
+                        continue; // now part of the literal
+                    cur.op = IR_PRINT_ARG;
+                    cur.imm = ++slot;
+                }
+                out[n++] = cur;
+            }
+
+            // the merged print belongs to the line of the first print in the run
+            IrInstr merged = { IR_PRINTF, 0, 0, 0, 0, strdup(label), run_line };
+            if(!args) {
+                IrInstr addr = { IR_ADDR, IrNewVreg(ir, IR_TYPE_ADDR), 0, 0, 0, strdup(label), run_line };
+                out[n++] = addr;
+                merged.op = IR_PRINT_STR;
+                merged.a = addr.dst;
+                free(merged.symbol);
+                merged.symbol = NULL;
+            }
+            out[n++] = merged;
+            stats->prints_merged += prints - 1;
+        }
+
+        free(block->instrs);
+        block->capacity = 2 * block->count + 2;
+        block->instrs = out;
+        block->count = n;
+    }
+
+    free(plain.data);
+    free(format.data);
+    free(defs);
+    stats->instrs_after = IrInstrCount(ir);
+}
+
+void IrPrintOptStats(const IrOptStats *stats, FILE *out) {
+    fprintf(out, "; optimizer: %d -> %d instructions (%d loads forwarded, %d redundant values, "
+                 "%d folded, %d dead stores, %d dead instructions, %d print syscalls merged)\n",
+            stats->instrs_before, stats->instrs_after, stats->loads_forwarded,
+            stats->values_numbered, stats->constants_folded, stats->dead_stores,
+            stats->dead_instrs, stats->prints_merged);
+}
@@ -0,0 +1,35 @@
+#ifndef IR_OPT_H
+#define IR_OPT_H
+
+#include <stdio.h>
+#include "ir.h"
+
+// what IrOptimize changed, for the report at the end of IR.txt
+typedef struct {
+    int instrs_before;
+    int instrs_after;
+    int loads_forwarded;   // variable loads replaced by the value last stored
+    int values_numbered;   // recomputations replaced by an earlier equal value
+    int constants_folded;
+    int dead_stores;
+    int dead_instrs;
+    int prints_merged;     // print syscalls saved by IrMergePrints
+} IrOptStats;
+
+// string literals the print merger can read and create
+typedef struct {
+    const char *(*text_of)(const char *label);  // contents of a literal, NULL if not constant
+    const char *(*label_for)(const char *text); // label of a literal with this text, NULL if none can be made
+} IrStringPool;
+
+// SSA construction over the variables, global value numbering, constant
+// folding and dead code elimination; stats may be NULL
+void IrOptimize(IrProgram *ir, IrOptStats *stats);
+
+// turn each run of prints into one print_str of a literal when every part is
+// known at compile time, otherwise into print_args and a single printf;
+// counts into stats (after IrOptimize, which clears it)
+void IrMergePrints(IrProgram *ir, const IrStringPool *pool, IrOptStats *stats);
+void IrPrintOptStats(const IrOptStats *stats, FILE *out);
+
+#endif
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "jit.h"
+#include "interpreter.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(JIT_DISABLED)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// one variable, as the VM keeps it: integer is 0 while the slot is uninitialized or holds a
+// string, so expressions read it without a check
+typedef struct {
+    long long integer;
+    const char *string;   // NULL unless the slot holds a string
+    size_t string_length;
+    bool initialized;
+} JitSlot;
+
+typedef void (*JitEntry)(JitSlot *slots, OutputCapture *out);
+
+struct JitProgram {
+    void *code;          // executable mapping
+    size_t code_size;
+    size_t mapped_size;
+    char **strings;      // string constants the code points at, owned
+    int string_count;
+    int slot_count;
+};
+
+// print statements' helpers for what depends on the slot's contents at run time
+
+static void jit_print_var(OutputCapture *out, const JitSlot *slot) {
+    if(!slot->initialized)
+        capture_append(out, "0", 1);
+    else if(slot->string)
+        capture_append(out, slot->string, slot->string_length);
+    else
+        capture_int(out, slot->integer);
+}
+
+static void jit_newline_unless_str(OutputCapture *out, const JitSlot *slot) {
+    if(!slot->string)
+        capture_append(out, "\n", 1);
+}
+
+static const char newline[] = "\n";
+
+#ifdef JIT_X86_64
+
+// ---- x86-64 encoding ----
+
+typedef struct {
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+    JitProgram *jit;
+} JitCompiler;
+
+static void emit_bytes(JitCompiler *c, const void *bytes, size_t n) {
+    if(c->count + n > c->capacity) {
+        c->capacity = c->capacity ? c->capacity * 2 : 4096;
+        while(c->count + n > c->capacity)
+            c->capacity *= 2;
+        c->bytes = realloc(c->bytes, c->capacity);
+    }
+    memcpy(c->bytes + c->count, bytes, n);
+    c->count += n;
+}
+
+static void emit_u8(JitCompiler *c, uint8_t b) {
+    emit_bytes(c, &b, 1);
+}
+
+static void emit_u32(JitCompiler *c, uint32_t v) {
+    uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+    emit_bytes(c, b, 4);
+}
+
+static void emit_u64(JitCompiler *c, uint64_t v) {
+    emit_u32(c, (uint32_t)v);
+    emit_u32(c, (uint32_t)(v >> 32));
+}
+
+// opcode bytes, then a [rbx + disp32] operand with reg in the ModRM reg field
+static void emit_rbx_operand(JitCompiler *c, const char *opcode, size_t n, int reg, int32_t disp) {
+    emit_bytes(c, opcode, n);
+    emit_u8(c, 0x80 | (reg << 3) | 3);
+    emit_u32(c, (uint32_t)disp);
+}
+
+static int fits_int32(long long v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+#define RAX 0
+#define RCX 1
+
+static int32_t slot_field(int slot, size_t offset) {
+    return (int32_t)(slot * sizeof(JitSlot) + offset);
+}
+
+// mov reg, imm (rax or rcx)
+static void emit_load_constant(JitCompiler *c, int reg, long long value) {
+    if(fits_int32(value)) {
+        emit_bytes(c, "\x48\xC7", 2);
+        emit_u8(c, 0xC0 | reg);
+        emit_u32(c, (uint32_t)value);
+    } else {
+        emit_u8(c, 0x48);
+        emit_u8(c, 0xB8 | reg);
+        emit_u64(c, (uint64_t)value);
+    }
+}
+
+// mov reg, [slot].integer
+static void emit_load_slot(JitCompiler *c, int reg, int slot) {
+    emit_rbx_operand(c, "\x48\x8B", 2, reg, slot_field(slot, offsetof(JitSlot, integer)));
+}
+
+// rax = rax / rcx: x / 0 is 0 and x / -1 is -x, as arith_div has it (idiv would trap)
+static void emit_divide(JitCompiler *c) {
+    static const uint8_t sequence[] = {
+        0x48, 0x85, 0xC9,        // test rcx, rcx
+        0x74, 18,                // jz zero
+        0x48, 0x83, 0xF9, 0xFF,  // cmp rcx, -1
+        0x74, 7,                 // je negate
+        0x48, 0x99,              // cqo
+        0x48, 0xF7, 0xF9,        // idiv rcx
+        0xEB, 7,                 // jmp done
+        0x48, 0xF7, 0xD8,        // negate: neg rax
+        0xEB, 2,                 // jmp done
+        0x31, 0xC0,              // zero: xor eax, eax
+    };                           // done:
+    emit_bytes(c, sequence, sizeof(sequence));
+}
+
+// rax = rax op rcx
+static void emit_binary(JitCompiler *c, int op) {
+    switch(op) {
+        case '+': emit_bytes(c, "\x48\x01\xC8", 3); break;     // add rax, rcx
+        case '-': emit_bytes(c, "\x48\x29\xC8", 3); break;     // sub rax, rcx
+        case '*': emit_bytes(c, "\x48\x0F\xAF\xC1", 4); break; // imul rax, rcx
+        default: emit_divide(c); break;
+    }
+}
+
+// rax = rax op literal, without going through rcx where an immediate form exists
+static void emit_binary_constant(JitCompiler *c, int op, long long value) {
+    if(op == '/') {
+        if(value == 0) {
+            emit_bytes(c, "\x31\xC0", 2);         // xor eax, eax
+        } else if(value == -1) {
+            emit_bytes(c, "\x48\xF7\xD8", 3);     // neg rax
+        } else if(value != 1) {
+            emit_load_constant(c, RCX, value);
+            emit_bytes(c, "\x48\x99\x48\xF7\xF9", 5); // cqo; idiv rcx
+        }
+        return;
+    }
+    if(!fits_int32(value)) {
+        emit_load_constant(c, RCX, value);
+        emit_binary(c, op);
+        return;
+    }
+    switch(op) {
+        case '+': emit_bytes(c, "\x48\x05", 2); break;     // add rax, imm32
+        case '-': emit_bytes(c, "\x48\x2D", 2); break;     // sub rax, imm32
+        default: emit_bytes(c, "\x48\x69\xC0", 3); break;  // imul rax, rax, imm32
+    }
+    emit_u32(c, (uint32_t)value);
+}
+
+// rax = rax op [slot].integer
+static void emit_binary_slot(JitCompiler *c, int op, int slot) {
+    int32_t disp = slot_field(slot, offsetof(JitSlot, integer));
+    switch(op) {
+        case '+': emit_rbx_operand(c, "\x48\x03", 2, RAX, disp); break;
+        case '-': emit_rbx_operand(c, "\x48\x2B", 2, RAX, disp); break;
+        case '*': emit_rbx_operand(c, "\x48\x0F\xAF", 3, RAX, disp); break;
+        default:
+            emit_load_slot(c, RCX, slot);
+            emit_divide(c);
+            break;
+    }
+}
+
+static int is_operator(int op) {
+    return op == '+' || op == '-' || op == '*' || op == '/';
+}
+
+// code that leaves the expression's value in rax (same results as evaluate_expression)
+static void compile_expression(JitCompiler *c, Node *node) {
+    if(!node) {
+        emit_bytes(c, "\x31\xC0", 2);
+        return;
+    }
+    switch(node->node_type) {
+        case 0: // NODE_NUM
+            emit_load_constant(c, RAX, node->int_val);
+            return;
+        case 2: // NODE_ID
+            emit_load_slot(c, RAX, node->slot);
+            return;
+        case 3: // NODE_BINOP
+        {
+            int op = node->binop.op;
+            if(!is_operator(op)) {
+                // '=' gives its left side, anything else 0
+                compile_expression(c, op == '=' ? node->binop.left : NULL);
+                return;
+            }
+            Node *right = node->binop.right;
+            if(right && right->node_type == 0) {
+                compile_expression(c, node->binop.left);
+                emit_binary_constant(c, op, right->int_val);
+            } else if(right && right->node_type == 2) {
+                compile_expression(c, node->binop.left);
+                emit_binary_slot(c, op, right->slot);
+            } else {
+                // no calls happen inside an expression, so the stack may go unaligned here
+                compile_expression(c, right);
+                emit_u8(c, 0x50);                  // push rax
+                compile_expression(c, node->binop.left);
+                emit_u8(c, 0x59);                  // pop rcx
+                emit_binary(c, op);
+            }
+            return;
+        }
+        default:
+            emit_bytes(c, "\x31\xC0", 2);
+            return;
+    }
+}
+
+// call function(out, ...) with the remaining arguments already in rsi/rdx
+static void emit_call(JitCompiler *c, const void *function) {
+    emit_bytes(c, "\x4C\x89\xE7", 3);              // mov rdi, r12
+    emit_bytes(c, "\x48\xB8", 2);                  // mov rax, function
+    emit_u64(c, (uint64_t)(uintptr_t)function);
+    emit_bytes(c, "\xFF\xD0", 2);                  // call rax
+}
+
+// capture_append(out, text, length)
+static void emit_append(JitCompiler *c, const char *text, size_t length) {
+    emit_bytes(c, "\x48\xBE", 2);                  // mov rsi, text
+    emit_u64(c, (uint64_t)(uintptr_t)text);
+    emit_bytes(c, "\x48\xBA", 2);                  // mov rdx, length
+    emit_u64(c, (uint64_t)length);
+    emit_call(c, (const void *)capture_append);
+}
+
+// helper(out, &slots[slot])
+static void emit_slot_call(JitCompiler *c, const void *helper, int slot) {
+    emit_rbx_operand(c, "\x48\x8D", 2, 6, slot_field(slot, 0)); // lea rsi, [rbx + slot]
+    emit_call(c, helper);
+}
+
+static const char *add_string(JitCompiler *c, const Node *str) {
+    JitProgram *jit = c->jit;
+    jit->strings = realloc(jit->strings, sizeof(char *) * (jit->string_count + 1));
+    char *copy = malloc(str->str_len + 1);
+    memcpy(copy, str->str_val, str->str_len);
+    copy[str->str_len] = '\0';
+    jit->strings[jit->string_count++] = copy;
+    return copy;
+}
+
+// the items of a declaration or assignment statement
+static void compile_items(JitCompiler *c, Node *item, int is_decl) {
+    for(; item; item = item->next) {
+        if(item->node_type == 3 && item->binop.op == '=') {
+            int slot = item->binop.left->slot;
+            compile_expression(c, item->binop.right);
+            emit_rbx_operand(c, "\x48\x89", 2, RAX, slot_field(slot, offsetof(JitSlot, integer)));
+            emit_rbx_operand(c, "\x48\xC7", 2, 0, slot_field(slot, offsetof(JitSlot, string)));
+            emit_u32(c, 0);
+            emit_rbx_operand(c, "\xC6", 1, 0, slot_field(slot, offsetof(JitSlot, initialized)));
+            emit_u8(c, 1);
+        } else if(item->node_type == NODE_STR_ASSIGN) {
+            int slot = item->str_assign.id->slot;
+            Node *str = item->str_assign.str;
+            emit_bytes(c, "\x31\xC0", 2);          // xor eax, eax
+            emit_rbx_operand(c, "\x48\x89", 2, RAX, slot_field(slot, offsetof(JitSlot, integer)));
+            emit_load_constant(c, RAX, (long long)(uintptr_t)add_string(c, str));
+            emit_rbx_operand(c, "\x48\x89", 2, RAX, slot_field(slot, offsetof(JitSlot, string)));
+            emit_load_constant(c, RAX, str->str_len);
+            emit_rbx_operand(c, "\x48\x89", 2, RAX, slot_field(slot, offsetof(JitSlot, string_length)));
+            emit_rbx_operand(c, "\xC6", 1, 0, slot_field(slot, offsetof(JitSlot, initialized)));
+            emit_u8(c, 1);
+        } else if(item->node_type == 2 && is_decl) {
+            // like the tree walker, a string declared again keeps its text but reads as 0
+            emit_rbx_operand(c, "\x48\xC7", 2, 0, slot_field(item->slot, offsetof(JitSlot, integer)));
+            emit_u32(c, 0);
+            emit_rbx_operand(c, "\xC6", 1, 0, slot_field(item->slot, offsetof(JitSlot, initialized)));
+            emit_u8(c, 0);
+        }
+    }
+}
+
+static void compile_print(JitCompiler *c, Node *part) {
+    Node *last = NULL;
+    for(; part; part = part->print_part.part_next) {
+        if(part->node_type != NODE_PRINT_PART)
+            continue;
+        Node *content = part->print_part.items;
+        if(content->node_type == 1) {
+            emit_append(c, add_string(c, content), content->str_len);
+        } else if(content->node_type == 2) {
+            emit_slot_call(c, (const void *)jit_print_var, content->slot);
+        } else {
+            compile_expression(c, content);
+            emit_bytes(c, "\x48\x89\xC6", 3);      // mov rsi, rax
+            emit_call(c, (const void *)capture_int);
+        }
+        last = content;
+    }
+    // no newline after a string, whether a literal or in a variable
+    if(!last || last->node_type == 1)
+        return;
+    if(last->node_type == 2)
+        emit_slot_call(c, (const void *)jit_newline_unless_str, last->slot);
+    else
+        emit_append(c, newline, 1);
+}
+
+int jit_available(void) {
+    return 1;
+}
+
+JitProgram *jit_compile(Node *program) {
+    JitCompiler c = { NULL, 0, 0, calloc(1, sizeof(JitProgram)) };
+    c.jit->slot_count = resolve_slots(program, NULL);
+
+    // rbx = slots, r12 = out; three pushes keep rsp 16-byte aligned for the calls
+    emit_bytes(&c, "\x53\x41\x54\x50", 4);         // push rbx; push r12; push rax
+    emit_bytes(&c, "\x48\x89\xFB", 3);             // mov rbx, rdi
+    emit_bytes(&c, "\x49\x89\xF4", 3);             // mov r12, rsi
+    for(Node *statement = program; statement; statement = statement->next) {
+        switch(statement->node_type) {
+            case 4: // NODE_DECL
+                compile_items(&c, statement->decl_assign.items, 1);
+                break;
+            case 5: // NODE_ASSIGN
+                compile_items(&c, statement->decl_assign.items, 0);
+                break;
+            case 6: // NODE_PRINT
+                compile_print(&c, statement->print_stmt.parts);
+                break;
+            default:
+                break;
+        }
+    }
+    emit_bytes(&c, "\x58\x41\x5C\x5B\xC3", 5);     // pop rax; pop r12; pop rbx; ret
+
+    // written while writable, then switched to executable
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped = (c.count + page - 1) / page * page;
+    void *code = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) {
+        free(c.bytes);
+        jit_free(c.jit);
+        return NULL;
+    }
+    memcpy(code, c.bytes, c.count);
+    free(c.bytes);
+    if(mprotect(code, mapped, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, mapped);
+        jit_free(c.jit);
+        return NULL;
+    }
+    c.jit->code = code;
+    c.jit->code_size = c.count;
+    c.jit->mapped_size = mapped;
+    return c.jit;
+}
+
+void jit_run(const JitProgram *jit, OutputCapture *out) {
+    JitSlot *slots = calloc(jit->slot_count ? jit->slot_count : 1, sizeof(JitSlot));
+    JitEntry entry;
+    // object to function pointer: fine on every platform that gets here
+    memcpy(&entry, &jit->code, sizeof(entry));
+    entry(slots, out);
+    free(slots);
+}
+
+#else
+
+int jit_available(void) {
+    return 0;
+}
+
+JitProgram *jit_compile(Node *program) {
+    (void)program;
+    (void)jit_print_var;
+    (void)jit_newline_unless_str;
+    (void)newline;
+    return NULL;
+}
+
+void jit_run(const JitProgram *jit, OutputCapture *out) {
+    (void)jit;
+    (void)out;
+}
+
+#endif
+
+void jit_free(JitProgram *jit) {
+    if(!jit)
+        return;
+#ifdef JIT_X86_64
+    if(jit->code)
+        munmap(jit->code, jit->mapped_size);
+#endif
+    for(int i = 0; i < jit->string_count; i++) {
+        free(jit->strings[i]);
+    }
+    free(jit->strings);
+    free(jit);
+}
+
+size_t jit_code_size(const JitProgram *jit) {
+    return jit->code_size;
+}
+
+int interpret_jit_into(Node *program, OutputCapture *output) {
+    JitProgram *jit = jit_compile(program);
+    if(!jit) {
+        interpret_into(program, output);
+        return 0;
+    }
+    jit_run(jit, output);
+    jit_free(jit);
+    return 1;
+}
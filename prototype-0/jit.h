@@ -0,0 +1,30 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "ast.h"
+#include "output.h"
+
+// x86-64 machine code for a program, run in-process: variables live in a frame of slots
+// addressed from rbx, expressions are evaluated in rax/rcx, and prints call the output
+// functions directly; the output is the same as the bytecode VM's
+typedef struct JitProgram JitProgram;
+
+// 1 if this build and machine can run JIT code (x86-64 with mmap)
+int jit_available(void);
+
+// program is the statement list of the AST; its ID nodes get their slots, and it is not
+// referenced afterwards; NULL if the JIT is unavailable or executable memory cannot be had
+JitProgram *jit_compile(Node *program);
+void jit_free(JitProgram *jit);
+
+// run on fresh variables, appending what the program prints to out
+void jit_run(const JitProgram *jit, OutputCapture *out);
+
+// bytes of machine code
+size_t jit_code_size(const JitProgram *jit);
+
+// compile and run, on the bytecode VM if the JIT is unavailable; 0 if it fell back
+int interpret_jit_into(Node *program, OutputCapture *output);
+
+#endif
@@ -515,6 +515,7 @@ char *yytext;
 #include <stdlib.h>
 #include <string.h>
 #include "parser.tab.h"
+#include "arith.h"
 
 int line_num = 1;
 int column_num = 1;
@@ -526,8 +527,8 @@ extern int found_prog_start;
 void update_column(int length);
 
 void yyerror(const char *s);
-#line 529 "lex.yy.c"
 #line 530 "lex.yy.c"
+#line 531 "lex.yy.c"
 
 #define INITIAL 0
 
@@ -744,10 +745,10 @@ YY_DECL
 		}
 
 	{
-#line 28 "lexer.l"
+#line 29 "lexer.l"
 
 
-#line 750 "lex.yy.c"
+#line 751 "lex.yy.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -806,12 +807,12 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 30 "lexer.l"
+#line 31 "lexer.l"
 { update_column(yyleng); /* ignore comments */ }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 32 "lexer.l"
+#line 33 "lexer.l"
 { 
                 update_column(3); 
                 found_prog_start = 1; // ended up not being used, so safe to comment out | update: now used
@@ -820,7 +821,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 37 "lexer.l"
+#line 38 "lexer.l"
 {   
                 update_column(3);
                 found_prog_end = 1;
@@ -829,31 +830,31 @@ YY_RULE_SETUP
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 43 "lexer.l"
+#line 44 "lexer.l"
 { update_column(3); return KW_INT; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 44 "lexer.l"
+#line 45 "lexer.l"
 { update_column(2); return KW_CH; }
 	YY_BREAK
 case 6:
-#line 46 "lexer.l"
-case 7:
 #line 47 "lexer.l"
-case 8:
+case 7:
 #line 48 "lexer.l"
-case 9:
+case 8:
 #line 49 "lexer.l"
-case 10:
+case 9:
 #line 50 "lexer.l"
-case 11:
+case 10:
 #line 51 "lexer.l"
-case 12:
+case 11:
 #line 52 "lexer.l"
+case 12:
+#line 53 "lexer.l"
 case 13:
 YY_RULE_SETUP
-#line 52 "lexer.l"
+#line 53 "lexer.l"
 { 
               update_column(yyleng); 
               //fprintf(stderr, "Line %d, column %d: Type '%s' not supported; only \"int\" & \"ch\"\n", 
@@ -863,57 +864,57 @@ YY_RULE_SETUP
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 58 "lexer.l"
+#line 59 "lexer.l"
 { update_column(1); return KW_PRINT; }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 60 "lexer.l"
+#line 61 "lexer.l"
 { update_column(1); return '='; }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 61 "lexer.l"
+#line 62 "lexer.l"
 { update_column(1); return '+'; }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 62 "lexer.l"
+#line 63 "lexer.l"
 { update_column(1); return '-'; }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 63 "lexer.l"
+#line 64 "lexer.l"
 { update_column(1); return '*'; }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 64 "lexer.l"
+#line 65 "lexer.l"
 { update_column(1); return '/'; }
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 65 "lexer.l"
+#line 66 "lexer.l"
 { update_column(1); return '('; }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 66 "lexer.l"
+#line 67 "lexer.l"
 { update_column(1); return ')'; }
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 67 "lexer.l"
+#line 68 "lexer.l"
 { update_column(1); return ','; }
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 68 "lexer.l"
+#line 69 "lexer.l"
 { update_column(1); return ':'; }
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 70 "lexer.l"
+#line 71 "lexer.l"
 {  // FIX 9: ; as terminator
               update_column(1);
               return SEMICOLON; 
@@ -921,7 +922,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 76 "lexer.l"
+#line 77 "lexer.l"
 { 
               yylval.str_val = strdup(yytext);
               update_column(yyleng);
@@ -930,7 +931,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 82 "lexer.l"
+#line 83 "lexer.l"
 { // FIX 2: Catch invalid IDs
     fprintf(stderr, "Line %d, column %d: '%s' is an invalid variable name (must consist of _, letters, & numbers, but must start w/ a letter)\n",
             line_num, column_num, yytext);
@@ -940,7 +941,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 89 "lexer.l"
+#line 90 "lexer.l"
 { // FIX 2: Catch invalid IDs ; starts with _
     //fprintf(stderr, "Line %d, column %d: Identifiers cannot start with underscore: '%s'\n",
     //        line_num, column_num, yytext);
@@ -950,7 +951,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 96 "lexer.l"
+#line 97 "lexer.l"
 {
               //fprintf(stderr, "Line %d: Invalid number '%s' (cannot mix digits and letters)\n", 
                 //      line_num, yytext);
@@ -960,16 +961,16 @@ YY_RULE_SETUP
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 103 "lexer.l"
+#line 104 "lexer.l"
 {
-              yylval.int_val = atoi(yytext);
+              yylval.int_val = arith_decimal(yytext); // modulo 2^64, like the target's arithmetic
               update_column(yyleng);
               return NUM;
             }
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 109 "lexer.l"
+#line 110 "lexer.l"
 {
               // string literal with escape sequences
               char *text = yytext;
@@ -1031,18 +1032,18 @@ YY_RULE_SETUP
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 168 "lexer.l"
+#line 169 "lexer.l"
 { update_column(yyleng); }
 	YY_BREAK
 case 32:
 /* rule 32 can match eol */
 YY_RULE_SETUP
-#line 170 "lexer.l"
+#line 171 "lexer.l"
 { line_num++; column_num = 1; return NEWLINE_TOKEN; }
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 172 "lexer.l"
+#line 173 "lexer.l"
 { 
               update_column(1);
               return ILLEGAL;
@@ -1050,10 +1051,10 @@ YY_RULE_SETUP
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 176 "lexer.l"
+#line 177 "lexer.l"
 ECHO;
 	YY_BREAK
-#line 1056 "lex.yy.c"
+#line 1057 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -2058,7 +2059,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 176 "lexer.l"
+#line 177 "lexer.l"
 
 
 void update_column(int length) {
@@ -2,7 +2,45 @@
 #define MACHINE_CODE_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include "instruction.h"
+#include "asm_buffer.h"
+#include "object_file.h"
 
-int MachineFromAssembly(const char *asm_file, const char *out_file);
+// I-type opcodes
+#define OP_DADDIU 0x19 // daddiu rt, rs, immediate
+#define OP_LD 0x37 // 64-bit load doubleword
+#define OP_SD 0x3F // 64-bit store doubleword
+#define OP_BEQ 0x04
+#define OP_BNE 0x05
+#define OP_LUI 0x0F // lui rt, immediate (upper 16 bits)
+#define OP_ORI 0x0D // ori rt, rs, immediate (zero-extended)
+
+// J-type opcodes
+#define OP_J 0x02
+
+// R-type function codes (funct field)
+#define FUNCT_DADDU 0x2D
+#define FUNCT_DSUBU 0x2F // FIX 13: from 23
+#define FUNCT_DMULT 0x18
+#define FUNCT_DDIV 0x1A
+#define FUNCT_MFHI 0x10
+#define FUNCT_MFLO 0x12
+#define FUNCT_SYSCALL 0x0C
+#define FUNCT_DSLL 0x38 // dsll rd, rt, sa
+#define FUNCT_SLTU 0x2B // sltu rd, rs, rt
+
+uint32_t Encode_R_Type(uint8_t rs, uint8_t rt, uint8_t rd, uint8_t shamt, uint8_t funct);
+uint32_t Encode_I_Type(uint8_t opcode, uint8_t rs, uint8_t rt, int16_t imm);
+uint32_t Encode_J_Type(uint8_t opcode, uint32_t target);
+
+// encode one instruction record (symbol offsets from the symbol table); 0 if it cannot be encoded
+int EncodeInstruction(const Instruction *ins, uint32_t *code);
+// append the code generator's instructions to image->code;
+// returns the number of instructions that could not be encoded
+int EncodeInstructions(const InstructionList *list, ObjectImage *image);
+
+// one listing line: "0110 0100 ... 0000  : 640A0000"
+void WriteMachineWord(AsmBuffer *buf, uint32_t code);
 
 #endif
\ No newline at end of file
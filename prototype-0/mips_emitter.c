@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "mips_emitter.h"
+#include "symbol_table.h"
+
+// r4 for syscall arguments
+// r10-r19 for temporary calculations
+// r2-r3 to reload operands that are not in a register
+// r14 for the printf parameter block address
+// r1 for the base of data beyond 32 KiB
+// r5-r6 to guard a division against a zero divisor
+#define DATA_BASE_REG 1
+#define ARG_REG 4
+#define PRINTF_REG 14
+#define TEMP_FIRST 10
+#define TEMP_LAST 19
+#define SCRATCH_A 2
+#define SCRATCH_B 3
+#define GUARD_A 5
+#define GUARD_B 6
+
+// where a vreg lives while it is not in a register
+typedef enum {
+    LOC_NONE = 0,
+    LOC_REG,     // in reg
+    LOC_SLOT,    // spilled to _tN
+    LOC_HOME,    // still equal to the variable it was stored to
+    LOC_REMAT    // constant or address, recomputed on every use
+} Location;
+
+typedef struct {
+    Location loc;
+    int reg;
+    int slot;
+    const IrInstr *def;
+    int *uses;          // indices of the reading instructions, ascending
+    int use_count;
+    int next_use;       // position in uses of the next reader
+    const char *home;   // variable holding the same value...
+    int home_from;      // ...after the store at this index...
+    int home_until;     // ...until the variable is stored again here
+} VregInfo;
+
+typedef struct {
+    InstructionList *code;
+    VregInfo *info;
+    int reg_owner[32];   // vreg living in each register
+    int next_temp;       // round-robin start for temporaries
+    int *slot_owner;     // vreg living in each spill slot
+    int slot_count;
+    int slot_capacity;
+} Emitter;
+
+// load immediate value into register, in as few instructions as the value needs:
+// daddiu or ori for 16 bits, lui + ori for 32, then dsll + ori per further 16 bits
+static void GenerateLoadImmediate(InstructionList *code, int reg, long long imm) {
+    if(imm >= -0x8000 && imm <= 0x7FFF) {
+        EmitInstruction(code, INS_DADDIU, 0, 0, reg, imm, NULL);
+        return;
+    }
+    if(imm >= 0 && imm <= 0xFFFF) {
+        EmitInstruction(code, INS_ORI, 0, 0, reg, imm, NULL);
+        return;
+    }
+    long long low = imm & 0xFFFF;
+    if(imm >= INT32_MIN && imm <= INT32_MAX) {
+        // lui sign-extends bit 31, which is already the value's sign
+        EmitInstruction(code, INS_LUI, 0, 0, reg, (imm >> 16) & 0xFFFF, NULL);
+    } else {
+        // the upper bits, shifted into place; low zero bits save the ori and allow a longer shift
+        int shift = 16;
+        if(low == 0) {
+            while(shift < 31 && !(imm & (1LL << shift)))
+                shift++;
+        }
+        GenerateLoadImmediate(code, reg, imm >> shift);
+        EmitInstruction(code, INS_DSLL, reg, 0, reg, shift, NULL);
+    }
+    if(low)
+        EmitInstruction(code, INS_ORI, 0, reg, reg, low, NULL);
+}
+
+// x + c and x - c with c in 16 bits become daddiu, x * 2^k becomes dsll, so the constant
+// needs no register; 1 with the immediate (or shift) in *imm
+static int ImmediateForm(const Emitter *em, const IrInstr *ins, long long *imm) {
+    if(ins->op != IR_ADD && ins->op != IR_SUB && ins->op != IR_MUL)
+        return 0;
+    const IrInstr *def = em->info[ins->b].def;
+    if(!def || def->op != IR_CONST)
+        return 0;
+    long long value = def->imm;
+    switch(ins->op) {
+        case IR_ADD:
+            *imm = value;
+            return value >= -0x8000 && value <= 0x7FFF;
+        case IR_SUB:
+            *imm = -value;
+            return value > -0x8000 && value <= 0x8000;
+        default:
+            // dsll shifts by 0..31
+            if(value <= 0 || (value & (value - 1)) || value > (1LL << 31))
+                return 0;
+            *imm = 0;
+            while((1LL << *imm) != value)
+                (*imm)++;
+            return 1;
+    }
+}
+
+// operands read from registers
+static int RegisterOperands(const Emitter *em, const IrInstr *ins) {
+    long long imm;
+    return ImmediateForm(em, ins, &imm) ? 1 : IrOperandCount(ins->op);
+}
+
+static int IsSyscall(IrOp op) {
+    return op == IR_PRINT_INT || op == IR_PRINT_STR || op == IR_PRINT_CHAR ||
+           op == IR_PRINTF || op == IR_EXIT;
+}
+
+static void SpillLabel(int slot, char *buf, size_t size) {
+    snprintf(buf, size, SPILL_LABEL_FORMAT, slot);
+}
+
+static int NewSpillSlot(Emitter *em, int vreg) {
+    for(int i = 0; i < em->slot_count; i++) {
+        if(em->slot_owner[i] == 0) {
+            em->slot_owner[i] = vreg;
+            return i;
+        }
+    }
+    if(em->slot_count >= em->slot_capacity) {
+        em->slot_capacity = em->slot_capacity ? em->slot_capacity * 2 : 8;
+        em->slot_owner = realloc(em->slot_owner, sizeof(int) * em->slot_capacity);
+    }
+    em->slot_owner[em->slot_count] = vreg;
+    return em->slot_count++;
+}
+
+// index of the first reader at or after position i (a large number if none)
+static int NextUse(VregInfo *vi, int i) {
+    while(vi->next_use < vi->use_count && vi->uses[vi->next_use] < i)
+        vi->next_use++;
+    return vi->next_use < vi->use_count ? vi->uses[vi->next_use] : 0x7fffffff;
+}
+
+static int LastUse(const VregInfo *vi) {
+    return vi->use_count ? vi->uses[vi->use_count - 1] : -1;
+}
+
+// register holding operand v, reloading it into scratch if it is not in one
+static int ReadOperand(Emitter *em, int v, int scratch) {
+    VregInfo *vi = &em->info[v];
+    char label[16];
+
+    switch(vi->loc) {
+        case LOC_REG:
+            return vi->reg;
+        case LOC_SLOT:
+            SpillLabel(vi->slot, label, sizeof(label));
+            EmitInstruction(em->code, INS_LD, 0, 0, scratch, 0, label);
+            return scratch;
+        case LOC_HOME:
+            EmitInstruction(em->code, INS_LD, 0, 0, scratch, 0, vi->home);
+            return scratch;
+        case LOC_REMAT:
+            if(vi->def->op == IR_ADDR)
+                EmitInstruction(em->code, INS_DADDIU, 0, 0, scratch, 0, vi->def->symbol);
+            else
+                GenerateLoadImmediate(em->code, scratch, vi->def->imm);
+            return scratch;
+        default:
+            return 0;
+    }
+}
+
+static void Release(Emitter *em, int v) {
+    VregInfo *vi = &em->info[v];
+    if(vi->loc == LOC_REG && em->reg_owner[vi->reg] == v)
+        em->reg_owner[vi->reg] = 0;
+    if(vi->loc == LOC_SLOT && em->slot_owner[vi->slot] == v)
+        em->slot_owner[vi->slot] = 0;
+}
+
+// move v out of its register at instruction i, storing it only if it cannot be recovered
+static void Evict(Emitter *em, int v, int i) {
+    VregInfo *vi = &em->info[v];
+    int reg = vi->reg;
+    em->reg_owner[reg] = 0;
+
+    if(vi->def->op == IR_CONST || vi->def->op == IR_ADDR) {
+        vi->loc = LOC_REMAT;
+    } else if(vi->home && vi->home_from < i && vi->home_until > LastUse(vi)) {
+        vi->loc = LOC_HOME;
+    } else {
+        char label[16];
+        vi->slot = NewSpillSlot(em, v);
+        vi->loc = LOC_SLOT;
+        SpillLabel(vi->slot, label, sizeof(label));
+        EmitInstruction(em->code, INS_SD, 0, 0, reg, 0, label);
+    }
+}
+
+// pick a register for the value defined at instruction i;
+// use_r4 when its only reader is the next syscall
+static int AllocateDst(Emitter *em, int v, int i, int use_r4) {
+    VregInfo *vi = &em->info[v];
+
+    if(vi->use_count == 0) {
+        vi->loc = LOC_NONE; // never read
+        return SCRATCH_A;
+    }
+
+    if(use_r4 && em->reg_owner[ARG_REG] == 0) {
+        vi->loc = LOC_REG;
+        vi->reg = ARG_REG;
+        em->reg_owner[ARG_REG] = v;
+        return ARG_REG;
+    }
+
+    int span = TEMP_LAST - TEMP_FIRST + 1;
+    int chosen = 0;
+    for(int k = 0; k < span && !chosen; k++) {
+        int r = TEMP_FIRST + (em->next_temp - TEMP_FIRST + k) % span;
+        if(em->reg_owner[r] == 0)
+            chosen = r;
+    }
+
+    if(!chosen) {
+        // all temporaries busy: evict whichever value is needed furthest in the future
+        int victim_reg = 0;
+        int furthest = NextUse(vi, i + 1);
+        for(int r = TEMP_FIRST; r <= TEMP_LAST; r++) {
+            int next = NextUse(&em->info[em->reg_owner[r]], i + 1);
+            if(next > furthest) {
+                furthest = next;
+                victim_reg = r;
+            }
+        }
+
+        if(!victim_reg) {
+            // the new value itself is the one to keep out of registers
+            if(vi->def->op == IR_CONST || vi->def->op == IR_ADDR) {
+                vi->loc = LOC_REMAT;
+            } else {
+                vi->loc = LOC_SLOT;
+                vi->slot = NewSpillSlot(em, v);
+            }
+            return SCRATCH_A;
+        }
+
+        Evict(em, em->reg_owner[victim_reg], i);
+        chosen = victim_reg;
+    }
+
+    em->reg_owner[chosen] = v;
+    em->next_temp = (chosen == TEMP_LAST) ? TEMP_FIRST : chosen + 1;
+    vi->loc = LOC_REG;
+    vi->reg = chosen;
+    return chosen;
+}
+
+void EmitMips(const IrProgram *ir, InstructionList *code, MipsLayout *layout) {
+    // flatten the blocks; the program is straight-line code
+    int n = IrInstrCount(ir);
+    const IrInstr **instrs = malloc(sizeof(IrInstr*) * (n + 1));
+    int k = 0;
+    for(int i = 0; i < ir->block_count; i++) {
+        for(int j = 0; j < ir->blocks[i].count; j++) {
+            instrs[k++] = &ir->blocks[i].instrs[j];
+        }
+    }
+
+    Emitter em;
+    memset(&em, 0, sizeof(em));
+    em.code = code;
+    em.next_temp = TEMP_FIRST;
+    em.info = calloc(ir->vreg_count + 1, sizeof(VregInfo));
+    int printf_words = 0;
+
+    // use lists, definitions, and the variable (if any) each value is stored to
+    int *syscalls_before = malloc(sizeof(int) * (n + 1));
+    int *use_pool = malloc(sizeof(int) * (2 * n + 1));
+    syscalls_before[0] = 0;
+    for(int i = 0; i < n; i++) {
+        const IrInstr *ins = instrs[i];
+        int operands = RegisterOperands(&em, ins);
+        if(ins->dst)
+            em.info[ins->dst].def = ins;
+        if(operands >= 1) em.info[ins->a].use_count++;
+        if(operands >= 2) em.info[ins->b].use_count++;
+        syscalls_before[i + 1] = syscalls_before[i] + (IsSyscall(ins->op) ? 1 : 0);
+    }
+    int offset = 0;
+    for(int v = 1; v <= ir->vreg_count; v++) {
+        em.info[v].uses = use_pool + offset;
+        offset += em.info[v].use_count;
+        em.info[v].use_count = 0;
+    }
+    for(int i = 0; i < n; i++) {
+        const IrInstr *ins = instrs[i];
+        int operands = RegisterOperands(&em, ins);
+        if(operands >= 1) {
+            VregInfo *vi = &em.info[ins->a];
+            vi->uses[vi->use_count++] = i;
+        }
+        if(operands >= 2 && ins->b != ins->a) {
+            VregInfo *vi = &em.info[ins->b];
+            vi->uses[vi->use_count++] = i;
+        }
+        if(ins->op == IR_STORE) {
+            // the variable keeps this value until its next store
+            int until = n;
+            for(int j = i + 1; j < n; j++) {
+                if(instrs[j]->op == IR_STORE && strcmp(instrs[j]->symbol, ins->symbol) == 0) {
+                    until = j;
+                    break;
+                }
+            }
+            VregInfo *vi = &em.info[ins->a];
+            if(!vi->home || until - i > vi->home_until - vi->home_from) {
+                vi->home = ins->symbol;
+                vi->home_from = i;
+                vi->home_until = until;
+            }
+        }
+    }
+
+    for(int i = 0; i < n; i++) {
+        const IrInstr *ins = instrs[i];
+        long long imm = 0;
+        int immediate = ImmediateForm(&em, ins, &imm);
+        int operands = immediate ? 1 : IrOperandCount(ins->op);
+        code->line = ins->line;
+        // a syscall argument is reloaded straight into r4
+        int scratch = IsSyscall(ins->op) ? ARG_REG : SCRATCH_A;
+        int ra = operands >= 1 ? ReadOperand(&em, ins->a, scratch) : 0;
+        int rb = operands >= 2 ? ReadOperand(&em, ins->b, SCRATCH_B) : 0;
+
+        // operands that die here free their registers for the result
+        if(operands >= 1 && LastUse(&em.info[ins->a]) == i)
+            Release(&em, ins->a);
+        if(operands >= 2 && LastUse(&em.info[ins->b]) == i)
+            Release(&em, ins->b);
+
+        int rd = 0;
+        if(ins->dst) {
+            VregInfo *vi = &em.info[ins->dst];
+            int use = LastUse(vi);
+            int use_r4 = vi->use_count == 1 && IsSyscall(instrs[use]->op) &&
+                         syscalls_before[use] == syscalls_before[i + 1];
+            rd = AllocateDst(&em, ins->dst, i, use_r4);
+
+            // unread values and constants kept out of registers are not computed here
+            if(vi->loc == LOC_REMAT || vi->loc == LOC_NONE)
+                continue;
+        }
+
+        switch(ins->op) {
+            case IR_CONST:
+                GenerateLoadImmediate(code, rd, ins->imm);
+                break;
+            case IR_ADDR:
+                EmitInstruction(code, INS_DADDIU, 0, 0, rd, 0, ins->symbol);
+                break;
+            case IR_LOAD:
+                EmitInstruction(code, INS_LD, 0, 0, rd, 0, ins->symbol);
+                break;
+            case IR_STORE:
+                EmitInstruction(code, INS_SD, 0, 0, ra, 0, ins->symbol);
+                break;
+            case IR_ADD:
+            case IR_SUB:
+                if(immediate)
+                    EmitInstruction(code, INS_DADDIU, 0, ra, rd, imm, NULL);
+                else
+                    EmitInstruction(code, ins->op == IR_ADD ? INS_DADDU : INS_DSUBU, rd, ra, rb, 0, NULL);
+                break;
+            case IR_MUL:
+                if(immediate) {
+                    EmitInstruction(code, INS_DSLL, rd, 0, ra, imm, NULL);
+                    break;
+                }
+                EmitInstruction(code, INS_DMULT, 0, ra, rb, 0, NULL);
+                EmitInstruction(code, INS_MFLO, rd, 0, 0, 0, NULL);
+                break;
+            case IR_DIV: {
+                // x / 0 is 0 in the language, but ddiv by zero traps on the target: unless the
+                // divisor is a nonzero constant, divide 0 by 1 instead, without a branch
+                const IrInstr *divisor = em.info[ins->b].def;
+                if(divisor->op == IR_CONST && divisor->imm != 0) {
+                    EmitInstruction(code, INS_DDIV, 0, ra, rb, 0, NULL);
+                    EmitInstruction(code, INS_MFLO, rd, 0, 0, 0, NULL);
+                    break;
+                }
+                EmitInstruction(code, INS_SLTU, GUARD_A, 0, rb, 0, NULL);      // 1 unless rb is 0
+                EmitInstruction(code, INS_DADDIU, 0, GUARD_A, GUARD_B, -1, NULL);  // 0, or -1 for 0
+                EmitInstruction(code, INS_DSUBU, GUARD_B, rb, GUARD_B, 0, NULL);  // rb, or 1 for 0
+                EmitInstruction(code, INS_DMULT, 0, ra, GUARD_A, 0, NULL);
+                EmitInstruction(code, INS_MFLO, GUARD_A, 0, 0, 0, NULL);          // ra, or 0 for 0
+                EmitInstruction(code, INS_DDIV, 0, GUARD_A, GUARD_B, 0, NULL);
+                EmitInstruction(code, INS_MFLO, rd, 0, 0, 0, NULL);
+                break;
+            }
+            case IR_PRINT_INT:
+            case IR_PRINT_STR:
+            case IR_PRINT_CHAR:
+                if(ra != ARG_REG)
+                    EmitInstruction(code, INS_DADDU, ARG_REG, ra, 0, 0, NULL);
+                EmitInstruction(code, INS_SYSCALL, 0, 0, 0,
+                                ins->op == IR_PRINT_INT ? 1 : ins->op == IR_PRINT_STR ? 4 : 11, NULL);
+                break;
+            case IR_PRINT_ARG: {
+                char label[16];
+                snprintf(label, sizeof(label), PRINTF_LABEL_FORMAT, (int)ins->imm);
+                EmitInstruction(code, INS_SD, 0, 0, ra, 0, label);
+                if(ins->imm + 1 > printf_words)
+                    printf_words = ins->imm + 1;
+                break;
+            }
+            case IR_PRINTF: {
+                // word 0 of the parameter block is the format string, r14 points at the block
+                if(em.reg_owner[PRINTF_REG])
+                    Evict(&em, em.reg_owner[PRINTF_REG], i);
+                char label[16];
+                snprintf(label, sizeof(label), PRINTF_LABEL_FORMAT, 0);
+                EmitInstruction(code, INS_DADDIU, 0, 0, SCRATCH_A, 0, ins->symbol);
+                EmitInstruction(code, INS_SD, 0, 0, SCRATCH_A, 0, label);
+                EmitInstruction(code, INS_DADDIU, 0, 0, PRINTF_REG, 0, label);
+                EmitInstruction(code, INS_SYSCALL, 0, 0, 0, 5, NULL);
+                if(printf_words < 1)
+                    printf_words = 1;
+                break;
+            }
+            case IR_EXIT:
+                EmitInstruction(code, INS_SYSCALL, 0, 0, 0, 10, NULL);
+                break;
+            default:
+                break;
+        }
+
+        if(ins->dst && em.info[ins->dst].loc == LOC_SLOT) {
+            char label[16];
+            SpillLabel(em.info[ins->dst].slot, label, sizeof(label));
+            EmitInstruction(code, INS_SD, 0, 0, rd, 0, label);
+        }
+    }
+
+    layout->spill_slots = em.slot_count;
+    layout->printf_words = printf_words;
+    free(em.slot_owner);
+    free(em.info);
+    free(use_pool);
+    free(syscalls_before);
+    free(instrs);
+}
+
+// segment s of the data covers s*64K-32K .. s*64K+32K-1, reached from r1 = s*64K;
+// segment 0 is the part r0 reaches
+#define DATA_SEGMENT_SHIFT 16
+
+// r1 = base (a multiple of 64K, so a single lui below 2G)
+static void GenerateLoadBase(InstructionList *code, uint64_t base) {
+    GenerateLoadImmediate(code, DATA_BASE_REG, (long long)base);
+}
+
+// past 32K, and known: an unknown label is left for the encoder to report
+static int IsFarSymbol(const char *symbol) {
+    uint64_t offset = symbol ? GetOffsetOfTheSymbol(symbol) : 0;
+    return offset > 0x7FFF && offset != (uint64_t)-1;
+}
+
+void AddressFarData(InstructionList *code) {
+    int far = 0;
+    for(int i = 0; i < code->count && !far; i++) {
+        far = IsFarSymbol(code->items[i].symbol);
+    }
+    if(!far)
+        return;
+
+    // .code is straight-line, so the segment in r1 is known at every point
+    InstructionList out;
+    InstructionListInit(&out);
+    uint64_t loaded = 0;
+    for(int i = 0; i < code->count; i++) {
+        Instruction ins = code->items[i];
+        uint64_t offset = ins.symbol ? GetOffsetOfTheSymbol(ins.symbol) : 0;
+        out.line = ins.line;
+        if(ins.rs == 0 && IsFarSymbol(ins.symbol)) {
+            uint64_t segment = (offset + 0x8000) >> DATA_SEGMENT_SHIFT;
+            if(segment != loaded) {
+                GenerateLoadBase(&out, segment << DATA_SEGMENT_SHIFT);
+                loaded = segment;
+            }
+            free(ins.symbol);
+            ins.symbol = NULL;
+            ins.rs = DATA_BASE_REG;
+            ins.imm = (long long)(offset - (segment << DATA_SEGMENT_SHIFT));
+        }
+        Instruction *copy = EmitInstruction(&out, ins.op, ins.rd, ins.rs, ins.rt, ins.imm, NULL);
+        copy->symbol = ins.symbol;
+    }
+    free(code->items);
+    *code = out;
+}
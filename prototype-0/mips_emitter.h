@@ -0,0 +1,28 @@
+#ifndef MIPS_EMITTER_H
+#define MIPS_EMITTER_H
+
+#include "ir.h"
+#include "instruction.h"
+
+// data label of spill slot n (declared as .space 8 by the caller)
+#define SPILL_LABEL_FORMAT "_t%d"
+// data label of word n of the printf parameter block; the words must be laid out
+// consecutively, word 0 holds the address of the format string
+#define PRINTF_LABEL_FORMAT "_pf%d"
+
+// data the emitted code needs besides the variables and literals
+typedef struct {
+    int spill_slots;   // _t0 .. _t(n-1)
+    int printf_words;  // _pf0 .. _pf(n-1), 0 if printf is not used
+} MipsLayout;
+
+// lower IR into MIPS64 instructions
+// vregs get r10-r19, values that are only printed go straight to r4 (syscall argument),
+// and when the temporaries run out values are spilled to _tN slots
+void EmitMips(const IrProgram *ir, InstructionList *code, MipsLayout *layout);
+
+// once the data layout is final: labels past the 32 KiB a 16-bit offset from r0 reaches
+// become numeric offsets from r1, which is loaded with the 64 KiB-aligned base of their segment
+void AddressFarData(InstructionList *code);
+
+#endif
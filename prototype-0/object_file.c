@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "object_file.h"
+#include "machine_code.h"
+#include "asm_buffer.h"
+
+void ObjectImageInit(ObjectImage *image) {
+    memset(image, 0, sizeof(*image));
+}
+
+void ObjectImageFree(ObjectImage *image) {
+    free(image->data);
+    free(image->code);
+    free(image->lines);
+    ObjectImageInit(image);
+}
+
+void ObjectAddWord(ObjectImage *image, uint32_t word, int line) {
+    if(image->code_count == image->code_capacity) {
+        image->code_capacity = image->code_capacity ? image->code_capacity * 2 : 256;
+        image->code = realloc(image->code, sizeof(uint32_t) * image->code_capacity);
+        image->lines = realloc(image->lines, sizeof(int) * image->code_capacity);
+    }
+    image->lines[image->code_count] = line;
+    image->code[image->code_count++] = word;
+}
+
+uint8_t *ObjectReserveData(ObjectImage *image, uint64_t size) {
+    if(size > image->data_capacity) {
+        uint64_t capacity = image->data_capacity ? image->data_capacity : 256;
+        while(capacity < size)
+            capacity *= 2;
+        image->data = realloc(image->data, capacity);
+        memset(image->data + image->data_capacity, 0, capacity - image->data_capacity);
+        image->data_capacity = capacity;
+    }
+    if(size > image->data_size)
+        image->data_size = size;
+    return image->data;
+}
+
+// BIG-ENDIAN WRITERS
+
+static uint8_t *Put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static uint8_t *Put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+static uint8_t *Put64(uint8_t *p, uint64_t v) {
+    p = Put32(p, (uint32_t)(v >> 32));
+    return Put32(p, (uint32_t)v);
+}
+
+// code words in target byte order
+static int WriteCode(const ObjectImage *image, FILE *out) {
+    uint8_t chunk[4096];
+    int i = 0;
+    while(i < image->code_count) {
+        uint8_t *p = chunk;
+        while(i < image->code_count && p < chunk + sizeof(chunk))
+            p = Put32(p, image->code[i++]);
+        if(fwrite(chunk, 1, p - chunk, out) != (size_t)(p - chunk))
+            return 0;
+    }
+    return 1;
+}
+
+int WriteRawBinary(const ObjectImage *image, FILE *out) {
+    return WriteCode(image, out);
+}
+
+// ELF64
+
+#define ELF_HEADER_SIZE 64
+#define ELF_SECTION_SIZE 64
+#define ELFCLASS64 2
+#define ELFDATA2MSB 2
+#define ET_REL 1
+#define EM_MIPS 8
+#define EF_MIPS_ARCH_64 0x60000000
+#define SHT_PROGBITS 1
+#define SHT_STRTAB 3
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+
+// section names, and each one's offset in it
+static const char elf_section_names[] = "\0.text\0.data\0.shstrtab";
+#define NAME_TEXT 1
+#define NAME_DATA 7
+#define NAME_SHSTRTAB 13
+
+static uint8_t *PutSection(uint8_t *p, uint32_t name, uint32_t type, uint64_t flags,
+                           uint64_t offset, uint64_t size, uint64_t align) {
+    p = Put32(p, name);
+    p = Put32(p, type);
+    p = Put64(p, flags);
+    p = Put64(p, 0);      // sh_addr: relocatable, placed by the loader
+    p = Put64(p, offset);
+    p = Put64(p, size);
+    p = Put32(p, 0);      // sh_link
+    p = Put32(p, 0);      // sh_info
+    p = Put64(p, align);
+    return Put64(p, 0);   // sh_entsize
+}
+
+static uint64_t Align(uint64_t n, uint64_t to) {
+    return (n + to - 1) & ~(to - 1);
+}
+
+// layout: header | .text | .data | .shstrtab | section headers
+int WriteElfObject(const ObjectImage *image, FILE *out) {
+    uint64_t text_offset = ELF_HEADER_SIZE;
+    uint64_t text_size = (uint64_t)image->code_count * 4;
+    uint64_t data_offset = Align(text_offset + text_size, 8);
+    uint64_t names_offset = data_offset + image->data_size;
+    uint64_t sections_offset = Align(names_offset + sizeof(elf_section_names), 8);
+
+    uint8_t header[ELF_HEADER_SIZE] = { 0x7F, 'E', 'L', 'F', ELFCLASS64, ELFDATA2MSB, 1 };
+    uint8_t *p = header + 16;
+    p = Put16(p, ET_REL);
+    p = Put16(p, EM_MIPS);
+    p = Put32(p, 1);               // e_version
+    p = Put64(p, 0);               // e_entry
+    p = Put64(p, 0);               // e_phoff: no program headers
+    p = Put64(p, sections_offset); // e_shoff
+    p = Put32(p, EF_MIPS_ARCH_64);
+    p = Put16(p, ELF_HEADER_SIZE);
+    p = Put16(p, 0);               // e_phentsize
+    p = Put16(p, 0);               // e_phnum
+    p = Put16(p, ELF_SECTION_SIZE);
+    p = Put16(p, 4);               // e_shnum: null, .text, .data, .shstrtab
+    Put16(p, 3);                   // e_shstrndx
+
+    uint8_t sections[4 * ELF_SECTION_SIZE] = { 0 };
+    p = sections + ELF_SECTION_SIZE;
+    p = PutSection(p, NAME_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset, text_size, 4);
+    p = PutSection(p, NAME_DATA, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, data_offset, image->data_size, 8);
+    PutSection(p, NAME_SHSTRTAB, SHT_STRTAB, 0, names_offset, sizeof(elf_section_names), 1);
+
+    static const uint8_t padding[8] = { 0 };
+    int ok = fwrite(header, 1, sizeof(header), out) == sizeof(header);
+    ok = ok && WriteCode(image, out);
+    ok = ok && fwrite(padding, 1, data_offset - (text_offset + text_size), out) == data_offset - (text_offset + text_size);
+    if(image->data_size)
+        ok = ok && fwrite(image->data, 1, image->data_size, out) == image->data_size;
+    ok = ok && fwrite(elf_section_names, 1, sizeof(elf_section_names), out) == sizeof(elf_section_names);
+    uint64_t pad = sections_offset - (names_offset + sizeof(elf_section_names));
+    ok = ok && fwrite(padding, 1, pad, out) == pad;
+    ok = ok && fwrite(sections, 1, sizeof(sections), out) == sizeof(sections);
+    return ok;
+}
+
+// LISTING
+
+static void ListBytes(const uint8_t *bytes, size_t size, FILE *out) {
+    AsmBuffer buf;
+    AsmBufferInit(&buf, out);
+    for(size_t i = 0; i + 4 <= size; i += 4) {
+        uint32_t word = (uint32_t)bytes[i] << 24 | (uint32_t)bytes[i + 1] << 16 |
+                        (uint32_t)bytes[i + 2] << 8 | bytes[i + 3];
+        WriteMachineWord(&buf, word);
+    }
+    AsmBufferFree(&buf);
+}
+
+int ListRawBinary(const char *bin_file, FILE *out) {
+#ifndef _WIN32
+    int fd = open(bin_file, O_RDONLY);
+    if(fd < 0)
+        return 0;
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return 0;
+    }
+    if(st.st_size > 0) {
+        void *bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(bytes == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        ListBytes(bytes, st.st_size, out);
+        munmap(bytes, st.st_size);
+    }
+    close(fd);
+    return 1;
+#else
+    // no mmap: read it whole
+    FILE *in = fopen(bin_file, "rb");
+    if(!in)
+        return 0;
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *bytes = malloc(size > 0 ? size : 1);
+    size_t n = fread(bytes, 1, size > 0 ? size : 0, in);
+    fclose(in);
+    ListBytes(bytes, n, out);
+    free(bytes);
+    return 1;
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// assembled program: the .data image and the encoded .code words
+// (data and code each start at address 0, as in EduMIPS64)
+typedef struct {
+    uint8_t *data;
+    uint64_t data_size;
+    uint64_t data_capacity;
+    uint32_t *code;
+    int *lines;         // source line of each code word, 0 if unknown
+    int code_count;
+    int code_capacity;
+} ObjectImage;
+
+void ObjectImageInit(ObjectImage *image);
+void ObjectImageFree(ObjectImage *image);
+void ObjectAddWord(ObjectImage *image, uint32_t word, int line);
+// grow .data to at least size bytes (new bytes are zero) and return the image
+uint8_t *ObjectReserveData(ObjectImage *image, uint64_t size);
+
+// raw binary: the code words, big-endian, nothing else (like objcopy -O binary -j .text)
+int WriteRawBinary(const ObjectImage *image, FILE *out);
+// minimal ELF64 big-endian MIPS relocatable object with .text and .data sections
+int WriteElfObject(const ObjectImage *image, FILE *out);
+
+// text view of a raw binary, one "0110 0100 ... : 640A0000" line per word;
+// the file is mapped instead of read; 0 if it cannot be opened
+int ListRawBinary(const char *bin_file, FILE *out);
+
+#endif
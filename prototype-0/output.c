@@ -3,34 +3,103 @@
 #include <stdarg.h>
 #include <string.h>
 #include "output.h"
+#include "asm_buffer.h"
 
 void capture_init(OutputCapture *cap) {
+    capture_init_sink(cap, NULL, 0);
+}
+
+void capture_init_sink(OutputCapture *cap, FILE *sink, int line_flush) {
     cap->capacity = 1024;
     cap->size = 0;
     cap->buffer = malloc(cap->capacity);
     cap->buffer[0] = '\0';
+    cap->sink = sink;
+    cap->line_flush = line_flush;
+    cap->flushed = 0;
 }
 
-void capture_write(OutputCapture *cap, const char *str) {
-    size_t len = strlen(str);
-    if(cap->size + len + 1 >= cap->capacity) {
-        cap->capacity = (cap->size + len + 1) * 2;
-        cap->buffer = realloc(cap->buffer, cap->capacity);
+void capture_flush(OutputCapture *cap) {
+    if(!cap->sink)
+        return;
+    if(cap->size > 0) {
+        fwrite(cap->buffer, 1, cap->size, cap->sink);
+        cap->flushed += cap->size;
+        cap->size = 0;
+        cap->buffer[0] = '\0';
     }
-    strcat(cap->buffer, str);
+    if(cap->line_flush)
+        fflush(cap->sink);
+}
+
+// after a write of len bytes: hand full chunks (or finished lines) to the sink
+static void capture_written(OutputCapture *cap, size_t len) {
+    if(!cap->sink)
+        return;
+    if(cap->size >= OUTPUT_CHUNK ||
+       (cap->line_flush && memchr(cap->buffer + cap->size - len, '\n', len)))
+        capture_flush(cap);
+}
+
+// room for extra more bytes and the terminator; doubling keeps appends linear overall
+static void capture_reserve(OutputCapture *cap, size_t extra) {
+    size_t needed = cap->size + extra + 1;
+    if(needed <= cap->capacity)
+        return;
+    size_t capacity = cap->capacity ? cap->capacity * 2 : 1024;
+    while(capacity < needed)
+        capacity *= 2;
+    cap->buffer = realloc(cap->buffer, capacity);
+    cap->capacity = capacity;
+}
+
+void capture_append(OutputCapture *cap, const char *str, size_t len) {
+    capture_reserve(cap, len);
+    memcpy(cap->buffer + cap->size, str, len);
     cap->size += len;
+    cap->buffer[cap->size] = '\0';
+    capture_written(cap, len);
+}
+
+void capture_int(OutputCapture *cap, long long value) {
+    // digit pairs straight into the buffer: no format string, no temporary, no strlen
+    capture_reserve(cap, 21);
+    char *start = cap->buffer + cap->size;
+    char *end = FormatInt(start, value);
+    *end = '\0';
+    cap->size += end - start;
+    if(cap->sink && cap->size >= OUTPUT_CHUNK)
+        capture_flush(cap);
+}
+
+void capture_write(OutputCapture *cap, const char *str) {
+    capture_append(cap, str, strlen(str));
 }
 
 void capture_printf(OutputCapture *cap, const char *format, ...) {
-    char buffer[1024];
+    // format straight into the free space; if it does not fit, grow to the exact size and redo
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    size_t room = cap->capacity - cap->size;
+    int len = vsnprintf(cap->buffer + cap->size, room, format, args);
     va_end(args);
-    capture_write(cap, buffer);
+    if(len < 0) {
+        if(room)
+            cap->buffer[cap->size] = '\0';
+        return;
+    }
+    if((size_t)len >= room) {
+        capture_reserve(cap, len);
+        va_start(args, format);
+        vsnprintf(cap->buffer + cap->size, len + 1, format, args);
+        va_end(args);
+    }
+    cap->size += len;
+    capture_written(cap, len);
 }
 
 void capture_free(OutputCapture *cap) {
+    capture_flush(cap);
     free(cap->buffer);
     cap->buffer = NULL;
     cap->size = cap->capacity = 0;
@@ -38,4 +107,4 @@ void capture_free(OutputCapture *cap) {
 
 const char* capture_get(OutputCapture *cap) {
     return cap->buffer;
-}
\ No newline at end of file
+}
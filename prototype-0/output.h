@@ -3,16 +3,33 @@
 
 #include <stdio.h>
 
+// growing text buffer; always NUL-terminated, writes append at buffer + size
+// with a sink, the text is written out in chunks as it grows, so only the unflushed tail is
+// held in memory; without one, everything is kept until capture_get
+#define OUTPUT_CHUNK (64 * 1024)
+
 typedef struct {
     char *buffer;
-    size_t size;
+    size_t size;      // bytes held, not counting the terminator
     size_t capacity;
+    FILE *sink;       // NULL keeps everything in memory
+    int line_flush;   // with a sink: also flush (and fflush the sink) after every newline
+    size_t flushed;   // bytes already written to the sink
 } OutputCapture;
 
 void capture_init(OutputCapture *cap);
+void capture_init_sink(OutputCapture *cap, FILE *sink, int line_flush);
 void capture_write(OutputCapture *cap, const char *str);
+void capture_append(OutputCapture *cap, const char *str, size_t len);
+// a number in decimal, the same text as "%lld" without going through printf
+void capture_int(OutputCapture *cap, long long value);
+// no length limit
 void capture_printf(OutputCapture *cap, const char *format, ...);
+// write what is held to the sink (nothing without one)
+void capture_flush(OutputCapture *cap);
+// flushes, then releases the memory
 void capture_free(OutputCapture *cap);
+// the text held, which with a sink is only what has not been flushed yet
 const char* capture_get(OutputCapture *cap);
 
 #endif
\ No newline at end of file
@@ -73,11 +73,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
 #include "semantics.h"
 #include "ast.h"
 #include "assembly.h"
 #include "machine_code.h"
+#include "assembler.h"
+#include "object_file.h"
+#include "simulator.h"
+#include "pipeline.h"
+#include "difftest.h"
 #include "interpreter.h"
+#include "bytecode.h"
+#include "jit.h"
+#include "c_emitter.h"
+#include "stats.h"
 
 #define NODE_PRINT_PART 7
 #define NODE_STR_ASSIGN 8 
@@ -95,10 +106,25 @@ Semantics sem_analyzer;
 extern int yylex();
 extern int yyparse();
 extern FILE *yyin;
+extern int line_num;
+extern int column_num;
 void yyerror(const char *s);
 int yylex_destroy(void);
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_string(const char *text);
+void yy_delete_buffer(YY_BUFFER_STATE buffer);
+
+// tokens the parser has read, for -stats
+static long long token_count = 0;
+static int counting_yylex(void) {
+    int token = yylex();
+    if(token)
+        token_count++;
+    return token;
+}
+#define yylex counting_yylex
 
-Node *create_num_node(int val);
+Node *create_num_node(long long val);
 Node *create_str_node(char *str);
 Node *create_id_node(char *name);
 Node *create_binop_node(int op, Node *left, Node *right);
@@ -117,7 +143,7 @@ void print_ast_to_file(Node *node, FILE *file, int depth);
 void save_ast_tree(Node *node, const char *filename);
 void print_tree(Node *node, FILE *file, int depth, int is_last, const char *prefix);
 
-#line 121 "parser.tab.c"
+#line 147 "parser.tab.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -568,11 +594,11 @@ static const yytype_int8 yytranslate[] =
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int16 yyrline[] =
 {
-       0,    73,    73,    79,    85,    91,   102,   107,   112,   117,
-     135,   142,   147,   151,   157,   168,   175,   193,   200,   206,
-     212,   218,   228,   235,   247,   255,   279,   287,   307,   324,
-     332,   338,   343,   352,   356,   370,   374,   378,   384,   388,
-     392,   398,   402,   410,   414
+       0,    99,    99,   105,   111,   117,   128,   133,   138,   143,
+     161,   168,   173,   177,   183,   194,   201,   219,   226,   232,
+     238,   244,   256,   263,   275,   283,   307,   315,   335,   352,
+     360,   366,   371,   380,   384,   398,   402,   406,   412,   416,
+     420,   426,   430,   438,   442
 };
 #endif
 
@@ -1180,72 +1206,72 @@ yyreduce:
   switch (yyn)
     {
   case 2: /* program: PROG_START lines PROG_END  */
-#line 74 "parser.y"
+#line 100 "parser.y"
     {
         ast_root = (yyvsp[-1].node_ptr);
         found_prog_start = 1;
         found_prog_end = 1;
     }
-#line 1190 "parser.tab.c"
+#line 1216 "parser.tab.c"
     break;
 
   case 3: /* program: PROG_START lines  */
-#line 80 "parser.y"
+#line 106 "parser.y"
     {
         ast_root = (yyvsp[0].node_ptr);
         found_prog_start = 1; 
         found_prog_end = 0; // another >>> issue
     }
-#line 1200 "parser.tab.c"
+#line 1226 "parser.tab.c"
     break;
 
   case 4: /* program: lines PROG_END  */
-#line 86 "parser.y"
+#line 112 "parser.y"
     {
         ast_root = (yyvsp[-1].node_ptr);
         found_prog_end = 1;
         found_prog_start = 0; // wasn't found
     }
-#line 1210 "parser.tab.c"
+#line 1236 "parser.tab.c"
     break;
 
   case 5: /* program: lines  */
-#line 92 "parser.y"
+#line 118 "parser.y"
     {
         ast_root = (yyvsp[0].node_ptr);
         found_prog_start = 0;
         found_prog_end = 0;
     }
-#line 1220 "parser.tab.c"
+#line 1246 "parser.tab.c"
     break;
 
   case 6: /* lines: line lines  */
-#line 103 "parser.y"
+#line 129 "parser.y"
     {
         (yyval.node_ptr) = append_to_list((Node*)(yyvsp[-1].node_ptr), (Node*)(yyvsp[0].node_ptr));
     }
-#line 1228 "parser.tab.c"
+#line 1254 "parser.tab.c"
     break;
 
   case 7: /* lines: %empty  */
-#line 107 "parser.y"
+#line 133 "parser.y"
     {
         (yyval.node_ptr) = NULL;
     }
-#line 1236 "parser.tab.c"
+#line 1262 "parser.tab.c"
     break;
 
   case 8: /* line: stmt NEWLINE_TOKEN  */
-#line 113 "parser.y"
+#line 139 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[-1].node_ptr);
         sem_set_line(&sem_analyzer, sem_analyzer.current_line + 1);
     }
-#line 1245 "parser.tab.c"
+#line 1271 "parser.tab.c"
     break;
 
   case 9: /* line: error NEWLINE_TOKEN  */
-#line 118 "parser.y"
+#line 144 "parser.y"
     {
         fprintf(stderr, "Line %d: Syntax error caused by any or one of the ff:\n\t"
         "(a) missing or extra ( or )\n\t"
@@ -1263,45 +1289,45 @@ yyreduce:
         sem_set_line(&sem_analyzer, sem_analyzer.current_line + 1);
         yyerrok;
     }
-#line 1267 "parser.tab.c"
+#line 1293 "parser.tab.c"
     break;
 
   case 10: /* line: NEWLINE_TOKEN  */
-#line 136 "parser.y"
+#line 162 "parser.y"
     {
         (yyval.node_ptr) = NULL;
         sem_set_line(&sem_analyzer, sem_analyzer.current_line + 1);
     }
-#line 1276 "parser.tab.c"
+#line 1302 "parser.tab.c"
     break;
 
   case 11: /* stmt: decl  */
-#line 143 "parser.y"
+#line 169 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[0].node_ptr);
         // removed for fix 4 as it should be done in decl rule itslef
     }
-#line 1285 "parser.tab.c"
+#line 1311 "parser.tab.c"
     break;
 
   case 12: /* stmt: print_stmt  */
-#line 148 "parser.y"
+#line 174 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[0].node_ptr);
     }
-#line 1293 "parser.tab.c"
+#line 1319 "parser.tab.c"
     break;
 
   case 13: /* stmt: assign  */
-#line 152 "parser.y"
+#line 178 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[0].node_ptr);
     }
-#line 1301 "parser.tab.c"
+#line 1327 "parser.tab.c"
     break;
 
   case 14: /* decl: KW_INT ID  */
-#line 158 "parser.y"
+#line 184 "parser.y"
     {
         sem_set_decl_line(&sem_analyzer, true); // to flag redeclaration
         if(sem_add_symbol(&sem_analyzer, (yyvsp[0].str_val), false)) {
@@ -1311,22 +1337,22 @@ yyreduce:
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1315 "parser.tab.c"
+#line 1341 "parser.tab.c"
     break;
 
   case 15: /* decl: KW_INT ID SEMICOLON  */
-#line 169 "parser.y"
+#line 195 "parser.y"
     {
         fprintf(stderr, "Line %d: Invalid line terminator; no need for ';' to end a line\n",
                 sem_analyzer.current_line);
         sem_analyzer.error_count++;
         (yyval.node_ptr) = NULL;
     }
-#line 1326 "parser.tab.c"
+#line 1352 "parser.tab.c"
     break;
 
   case 16: /* decl: KW_INT ID '=' expr  */
-#line 176 "parser.y"
+#line 202 "parser.y"
     {
         sem_set_decl_line(&sem_analyzer, true);
         if(!sem_check_division_by_zero((Node*)(yyvsp[0].node_ptr))) {
@@ -1344,77 +1370,79 @@ yyreduce:
             }
         }
     }
-#line 1348 "parser.tab.c"
+#line 1374 "parser.tab.c"
     break;
 
   case 17: /* decl: KW_INT ID '=' expr SEMICOLON  */
-#line 194 "parser.y"
+#line 220 "parser.y"
     {
         fprintf(stderr, "Line %d: Invalid line terminator; no need for ';' to end a line\n",
                 sem_analyzer.current_line);
         sem_analyzer.error_count++;
         (yyval.node_ptr) = NULL;
     }
-#line 1359 "parser.tab.c"
+#line 1385 "parser.tab.c"
     break;
 
   case 18: /* decl: KW_INT ID '=' expr ',' ID  */
-#line 201 "parser.y"
+#line 227 "parser.y"
     {
         fprintf(stderr, "Line %d: Only one declaration per line allowed. Use separate lines.\n",
                 sem_analyzer.current_line);
         (yyval.node_ptr) = NULL;
     }
-#line 1369 "parser.tab.c"
+#line 1395 "parser.tab.c"
     break;
 
   case 19: /* decl: KW_INT ID '=' STR  */
-#line 207 "parser.y"
+#line 233 "parser.y"
     {
         fprintf(stderr, "Line %d: Cannot assign string to integer variable '%s'\n",
                 sem_analyzer.current_line, (yyvsp[-2].str_val));
         (yyval.node_ptr) = NULL;
     }
-#line 1379 "parser.tab.c"
+#line 1405 "parser.tab.c"
     break;
 
   case 20: /* decl: KW_INT ID ',' ID  */
-#line 213 "parser.y"
+#line 239 "parser.y"
     {
         fprintf(stderr, "Line %d: Only one declaration per line allowed. Use separate lines.\n",
                 sem_analyzer.current_line);
         (yyval.node_ptr) = NULL;
     }
-#line 1389 "parser.tab.c"
+#line 1415 "parser.tab.c"
     break;
 
   case 21: /* decl: KW_CH ID  */
-#line 219 "parser.y"
+#line 245 "parser.y"
     {
         sem_set_decl_line(&sem_analyzer, true); // to flag redeclaration
         if(sem_add_symbol(&sem_analyzer, (yyvsp[0].str_val), true)) {
+            // a ch variable starts out empty, as an int one starts at 0
             Node *id_node = create_id_node((yyvsp[0].str_val));
-            (yyval.node_ptr) = create_decl_node(id_node);
+            Node *str_assign = create_str_assign_node(id_node, create_str_node(""));
+            (yyval.node_ptr) = create_decl_node(str_assign);
         } else {
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1403 "parser.tab.c"
+#line 1431 "parser.tab.c"
     break;
 
   case 22: /* decl: KW_CH ID SEMICOLON  */
-#line 229 "parser.y"
+#line 257 "parser.y"
     {
         fprintf(stderr, "Line %d: Invalid line terminator; no need for ';' to end a line\n",
                 sem_analyzer.current_line);
         sem_analyzer.error_count++;
         (yyval.node_ptr) = NULL;
     }
-#line 1414 "parser.tab.c"
+#line 1442 "parser.tab.c"
     break;
 
   case 23: /* decl: KW_CH ID '=' STR  */
-#line 236 "parser.y"
+#line 264 "parser.y"
     {
         sem_set_decl_line(&sem_analyzer, true); // to flag redeclaration
         if(sem_add_symbol(&sem_analyzer, (yyvsp[-2].str_val), true)) {
@@ -1426,22 +1454,22 @@ yyreduce:
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1430 "parser.tab.c"
+#line 1458 "parser.tab.c"
     break;
 
   case 24: /* decl: KW_CH ID '=' STR SEMICOLON  */
-#line 248 "parser.y"
+#line 276 "parser.y"
     {
         fprintf(stderr, "Line %d: Invalid line terminator; no need for ';' to end a line\n",
                 sem_analyzer.current_line);
         sem_analyzer.error_count++;
         (yyval.node_ptr) = NULL;
     }
-#line 1441 "parser.tab.c"
+#line 1469 "parser.tab.c"
     break;
 
   case 25: /* decl: KW_CH ID '=' expr  */
-#line 256 "parser.y"
+#line 284 "parser.y"
     {
         sem_set_decl_line(&sem_analyzer, true);
         
@@ -1465,21 +1493,21 @@ yyreduce:
             }
         }
     }
-#line 1469 "parser.tab.c"
+#line 1497 "parser.tab.c"
     break;
 
   case 26: /* decl: KW_CH ID ',' ID  */
-#line 280 "parser.y"
+#line 308 "parser.y"
     {
         fprintf(stderr, "Line %d: Only one declaration per line allowed. Use separate lines.\n",
                 sem_analyzer.current_line);
         (yyval.node_ptr) = NULL;
     }
-#line 1479 "parser.tab.c"
+#line 1507 "parser.tab.c"
     break;
 
   case 27: /* assign: ID '=' expr  */
-#line 288 "parser.y"
+#line 316 "parser.y"
     {
         if(sem_check_declared(&sem_analyzer, (yyvsp[-2].str_val))) {
             if(sem_is_string_type(&sem_analyzer, (yyvsp[-2].str_val))) {
@@ -1499,11 +1527,11 @@ yyreduce:
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1503 "parser.tab.c"
+#line 1531 "parser.tab.c"
     break;
 
   case 28: /* assign: ID '=' STR  */
-#line 308 "parser.y"
+#line 336 "parser.y"
     {
         if(sem_check_declared(&sem_analyzer, (yyvsp[-2].str_val))) {
             if(!sem_is_string_type(&sem_analyzer, (yyvsp[-2].str_val))) {
@@ -1520,57 +1548,57 @@ yyreduce:
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1524 "parser.tab.c"
+#line 1552 "parser.tab.c"
     break;
 
   case 29: /* assign: ID '=' expr ',' ID '=' expr  */
-#line 325 "parser.y"
+#line 353 "parser.y"
     {
         fprintf(stderr, "Line %d: Only one assignment per line allowed. Use separate lines.\n",
                 sem_analyzer.current_line);
         (yyval.node_ptr) = NULL;
     }
-#line 1534 "parser.tab.c"
+#line 1562 "parser.tab.c"
     break;
 
   case 30: /* print_stmt: KW_PRINT ':' print_list  */
-#line 333 "parser.y"
+#line 361 "parser.y"
     {
         (yyval.node_ptr) = create_print_node((Node*)(yyvsp[0].node_ptr));
     }
-#line 1542 "parser.tab.c"
+#line 1570 "parser.tab.c"
     break;
 
   case 31: /* print_list: print_item  */
-#line 339 "parser.y"
+#line 367 "parser.y"
     {
         Node *wrapped = create_print_part_node((yyvsp[0].node_ptr));
         (yyval.node_ptr) = wrapped;
     }
-#line 1551 "parser.tab.c"
+#line 1579 "parser.tab.c"
     break;
 
   case 32: /* print_list: print_item ',' print_list  */
-#line 344 "parser.y"
+#line 372 "parser.y"
     {
         Node *first_wrapped = create_print_part_node((yyvsp[-2].node_ptr));
         // Chain print parts using print_part.part_next
         first_wrapped->print_part.part_next = (yyvsp[0].node_ptr);
         (yyval.node_ptr) = first_wrapped;
     }
-#line 1562 "parser.tab.c"
+#line 1590 "parser.tab.c"
     break;
 
   case 33: /* print_item: STR  */
-#line 353 "parser.y"
+#line 381 "parser.y"
     {
         (yyval.node_ptr) = create_str_node((yyvsp[0].str_val));
     }
-#line 1570 "parser.tab.c"
+#line 1598 "parser.tab.c"
     break;
 
   case 34: /* print_item: expr  */
-#line 357 "parser.y"
+#line 385 "parser.y"
     {
         // NEW: Check if expression is valid for print statement
         // (no string variables in arithmetic expressions)
@@ -1582,67 +1610,67 @@ yyreduce:
             (yyval.node_ptr) = (yyvsp[0].node_ptr);
         }
     }
-#line 1586 "parser.tab.c"
+#line 1614 "parser.tab.c"
     break;
 
   case 35: /* expr: expr '+' term  */
-#line 371 "parser.y"
+#line 399 "parser.y"
     {
         (yyval.node_ptr) = create_binop_node('+', (Node*)(yyvsp[-2].node_ptr), (Node*)(yyvsp[0].node_ptr));
     }
-#line 1594 "parser.tab.c"
+#line 1622 "parser.tab.c"
     break;
 
   case 36: /* expr: expr '-' term  */
-#line 375 "parser.y"
+#line 403 "parser.y"
     {
         (yyval.node_ptr) = create_binop_node('-', (Node*)(yyvsp[-2].node_ptr), (Node*)(yyvsp[0].node_ptr));
     }
-#line 1602 "parser.tab.c"
+#line 1630 "parser.tab.c"
     break;
 
   case 37: /* expr: term  */
-#line 379 "parser.y"
+#line 407 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[0].node_ptr);
     }
-#line 1610 "parser.tab.c"
+#line 1638 "parser.tab.c"
     break;
 
   case 38: /* term: term '*' factor  */
-#line 385 "parser.y"
+#line 413 "parser.y"
     {
         (yyval.node_ptr) = create_binop_node('*', (Node*)(yyvsp[-2].node_ptr), (Node*)(yyvsp[0].node_ptr));
     }
-#line 1618 "parser.tab.c"
+#line 1646 "parser.tab.c"
     break;
 
   case 39: /* term: term '/' factor  */
-#line 389 "parser.y"
+#line 417 "parser.y"
     {
         (yyval.node_ptr) = create_binop_node('/', (Node*)(yyvsp[-2].node_ptr), (Node*)(yyvsp[0].node_ptr));
     }
-#line 1626 "parser.tab.c"
+#line 1654 "parser.tab.c"
     break;
 
   case 40: /* term: factor  */
-#line 393 "parser.y"
+#line 421 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[0].node_ptr);
     }
-#line 1634 "parser.tab.c"
+#line 1662 "parser.tab.c"
     break;
 
   case 41: /* factor: NUM  */
-#line 399 "parser.y"
+#line 427 "parser.y"
     {
         (yyval.node_ptr) = create_num_node((yyvsp[0].int_val));
     }
-#line 1642 "parser.tab.c"
+#line 1670 "parser.tab.c"
     break;
 
   case 42: /* factor: ID  */
-#line 403 "parser.y"
+#line 431 "parser.y"
     {
         if(sem_check_declared(&sem_analyzer, (yyvsp[0].str_val))) {
             (yyval.node_ptr) = create_id_node((yyvsp[0].str_val));
@@ -1650,28 +1678,28 @@ yyreduce:
             (yyval.node_ptr) = NULL;
         }
     }
-#line 1654 "parser.tab.c"
+#line 1682 "parser.tab.c"
     break;
 
   case 43: /* factor: '(' expr ')'  */
-#line 411 "parser.y"
+#line 439 "parser.y"
     {
         (yyval.node_ptr) = (yyvsp[-1].node_ptr);
     }
-#line 1662 "parser.tab.c"
+#line 1690 "parser.tab.c"
     break;
 
   case 44: /* factor: '-' factor  */
-#line 415 "parser.y"
+#line 443 "parser.y"
     {
         Node *neg_one = create_num_node(-1);
         (yyval.node_ptr) = create_binop_node('*', neg_one, (Node*)(yyvsp[0].node_ptr));
     }
-#line 1671 "parser.tab.c"
+#line 1699 "parser.tab.c"
     break;
 
 
-#line 1675 "parser.tab.c"
+#line 1703 "parser.tab.c"
 
       default: break;
     }
@@ -1864,7 +1892,7 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 420 "parser.y"
+#line 448 "parser.y"
 
 
 // no content should be after <<<
@@ -1974,7 +2002,7 @@ void print_tree(Node *node, FILE *file, int depth, int is_last, const char *pref
     // Print node content
     switch(node->node_type) {
         case 0: // NODE_NUM
-            fprintf(file, "● NUM: %d\n", node->int_val);
+            fprintf(file, "● NUM: %lld\n", node->int_val);
             break;
             
         case 1: // NODE_STR
@@ -2099,7 +2127,7 @@ void print_ast_to_console(Node *node, int depth) {
     
     switch(node->node_type) {
         case 0: // NODE_NUM
-            printf("NUM: %d\n", node->int_val);
+            printf("NUM: %lld\n", node->int_val);
             break;
             
         case 1: // NODE_STR
@@ -2186,7 +2214,7 @@ void print_ast_to_file(Node *node, FILE *file, int depth) {
     
     switch(node->node_type) {
         case 0: // NODE_NUM
-            fprintf(file, "NUM: %d\n", node->int_val);
+            fprintf(file, "NUM: %lld\n", node->int_val);
             break;
             
         case 1: // NODE_STR
@@ -2273,39 +2301,147 @@ void save_ast_to_file(Node *node, const char *filename) {
     fclose(file);
 }
 
-int main(int argc, char **argv) {
-    int error_count = 0;
+// name with its extension (if it is the given one) replaced: ("out.s", ".s", ".bin") -> "out.bin"
+static char *output_name(const char *name, const char *old_extension, const char *new_extension) {
+    const char *dot = strrchr(name, '.');
+    size_t stem = (dot && strcmp(dot, old_extension) == 0) ? (size_t)(dot - name) : strlen(name);
+    char *result = malloc(stem + strlen(new_extension) + 1);
+    memcpy(result, name, stem);
+    strcpy(result + stem, new_extension);
+    return result;
+}
 
-    char *asm_filename = "MIPS64.s";
-    char *machine_filename = "MACHINE_CODE.mc";
-    
-    if(argc >= 3) {
-        asm_filename = argv[2];
-        // create machine code filename from assembly filename
-        char *dot = strrchr(asm_filename, '.');
-        if(dot && strcmp(dot, ".s") == 0) {
-            // replace .s with .mc
-            strcpy(dot, ".mc");
-            machine_filename = asm_filename;
-            strcpy(dot, ".s"); // restore .s
-        } else {
-            // append .mc
-            machine_filename = malloc(strlen(asm_filename) + 4);
-            sprintf(machine_filename, "%s.mc", asm_filename);
+// stem.bin always; the stem.mc listing (read back from stem.bin) and a stem.o ELF object on request
+static void write_object_files(const ObjectImage *image, const char *stem, int listing, int elf) {
+    char *bin_filename = output_name(stem, "", ".bin");
+    FILE *bin = fopen(bin_filename, "wb");
+    if(!bin || !WriteRawBinary(image, bin))
+        fprintf(stderr, "Error: Cannot write machine code file %s\n", bin_filename);
+    if(bin)
+        fclose(bin);
+
+    if(listing) {
+        char *mc_filename = output_name(stem, "", ".mc");
+        FILE *mc = fopen(mc_filename, "w");
+        if(!mc || !ListRawBinary(bin_filename, mc))
+            fprintf(stderr, "Error: Cannot write machine code listing %s\n", mc_filename);
+        if(mc)
+            fclose(mc);
+        free(mc_filename);
+    }
+
+    if(elf) {
+        char *elf_filename = output_name(stem, "", ".o");
+        FILE *object = fopen(elf_filename, "wb");
+        if(!object || !WriteElfObject(image, object))
+            fprintf(stderr, "Error: Cannot write object file %s\n", elf_filename);
+        if(object)
+            fclose(object);
+        free(elf_filename);
+    }
+    free(bin_filename);
+}
+
+// -emit-c: the program as C in NATIVE.c; -native: also compiled with cc -O2 into ./NATIVE
+#define NATIVE_C_FILE "NATIVE.c"
+#define NATIVE_EXECUTABLE "NATIVE"
+
+static int write_native_program(Node *program, int build) {
+    FILE *c_file = fopen(NATIVE_C_FILE, "w");
+    if(!c_file) {
+        fprintf(stderr, "Error: Cannot open C file %s\n", NATIVE_C_FILE);
+        return 0;
+    }
+    GenerateCProgram(program, c_file);
+    fclose(c_file);
+    return !build || BuildNativeExecutable(NATIVE_C_FILE, "./" NATIVE_EXECUTABLE);
+}
+
+// run the machine code in the built-in simulator, output to stdout (discarded when quiet);
+// pipeline, if given, is fed every executed instruction; the bytes printed go to
+// output_bytes unless it is NULL; 0 if it faulted
+static int run_simulator(const ObjectImage *image, int report, PipelineModel *pipeline, int quiet,
+                         long long *output_bytes) {
+    AsmBuffer out;
+    AsmBufferInit(&out, quiet ? NULL : stdout);
+    SimOptions options = { 0 };
+    options.trace = pipeline ? PipelineStep : NULL;
+    options.trace_context = pipeline;
+    SimResult result;
+    clock_t start = clock();
+    Simulate(image, &out, &options, &result);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    AsmBufferFree(&out);
+    fflush(stdout);
+    if(output_bytes)
+        *output_bytes = out.flushed;
+
+    if(result.status == SIM_FAULT)
+        fprintf(stderr, "Simulator: %s at 0x%04X\n", result.fault, result.fault_pc);
+    if(report)
+        fprintf(stderr, "Simulated %lld instructions in %.3f s (%.1f M instructions/s)\n",
+                result.instructions, seconds, seconds > 0 ? result.instructions / seconds / 1e6 : 0.0);
+    return result.status != SIM_FAULT;
+}
+
+// statements and everything under them
+static long long count_nodes(const Node *node) {
+    long long count = 0;
+    for(; node; node = node->next) {
+        count++;
+        switch(node->node_type) {
+            case 3: // BINOP
+                count += count_nodes(node->binop.left) + count_nodes(node->binop.right);
+                break;
+            case 4: // DECL
+            case 5: // ASSIGN
+                count += count_nodes(node->decl_assign.items);
+                break;
+            case 6: // PRINT
+                count += count_nodes(node->print_stmt.parts);
+                break;
+            case 7: // PRINT_PART
+                count += count_nodes(node->print_part.items) + count_nodes(node->print_part.part_next);
+                break;
+            case 8: // STR_ASSIGN
+                count += count_nodes(node->str_assign.id) + count_nodes(node->str_assign.str);
+                break;
         }
     }
+    return count;
+}
+
+// parse and check one source file, then write its assembly to asm_filename and encode the
+// machine code into image; ast_root is left for the caller to interpret and free
+// stats, if given, gets the parse, ast-dump and codegen phases and what they made
+// 0 on success, otherwise the error count (at least 1); a program that parses and checks but
+// cannot be encoded is still valid: *codegen_errors gets those and image is left unusable
+static int compile_file(const char *source_filename, const char *asm_filename, CodegenOptions options, ObjectImage *image,
+                        Stats *stats, int *codegen_errors) {
+    int error_count = 0;
+    *codegen_errors = 0;
+
+    // the lexer and parser keep their state in globals; start every file afresh
+    found_prog_start = 0;
+    found_prog_end = 0;
+    ast_root = NULL;
+    line_num = 1;
+    column_num = 1;
+    token_count = 0;
     
     // initialize semantic analyzer
     sem_init(&sem_analyzer);
     sem_set_line(&sem_analyzer, 1);
     
-    yyin = fopen(argv[1], "r");
+    yyin = fopen(source_filename, "r");
     if(!yyin) {
-        fprintf(stderr, "Error: Cannot open file %s\n", argv[1]);
+        fprintf(stderr, "Error: Cannot open file %s\n", source_filename);
         sem_cleanup(&sem_analyzer);
         return 1;
     }
     
+    // semantic checks run in the grammar actions, so they are part of this phase
+    stats_begin(stats, "parse");
     int parse_result = yyparse();
     
     // delimiters r necessaryyy
@@ -2323,60 +2459,711 @@ int main(int argc, char **argv) {
     }
     
     // Check for content AFTER <<< (LAST)
-    int after_error = check_content_after_end_delimiter(argv[1]);
+    int after_error = check_content_after_end_delimiter(source_filename);
     
     // TOTAL errors
     int total_errors = error_count + after_error;
+    stats_end(stats);
+    if(stats) {
+        stats->tokens = token_count;
+        stats->nodes = count_nodes(ast_root);
+        stats->symbols = 0;
+        for(const Symbol *symbol = sem_analyzer.symbol_table; symbol; symbol = symbol->next) {
+            stats->symbols++;
+        }
+    }
 
     if(parse_result == 0 && error_count == 0) {
+        stats_begin(stats, "ast-dump");
         // Generate ASCII tree AST (NEW - this is what you want)
         save_ast_tree(ast_root, "AST.txt");
         
         // Also keep the old format if needed
         save_ast_to_file(ast_root, "AST_DUMP.txt");
+        stats_end(stats);
         
         // open output file for assembly
         FILE *asm_file = fopen(asm_filename, "w");
         if(!asm_file) {
             fprintf(stderr, "Error: Cannot open assembly file %s\n", asm_filename);
-            fclose(yyin);
-            sem_cleanup(&sem_analyzer);
+            error_count = 1;
+        } else {
+            // generate MIPS64 assembly (and the IR listing it was emitted from)
+            options.ir_dump = fopen("IR.txt", "w");
+            // machine code is encoded from the same instructions, not re-read from the .s file
+            options.object = image;
+            stats_begin(stats, "codegen");
+            *codegen_errors = GenerateAssemblyProgram(ast_root, asm_file, &options);
+            fclose(asm_file);
+            if(options.ir_dump)
+                fclose(options.ir_dump);
+            stats_end(stats);
+            if(stats)
+                stats->instructions = image->code_count;
+            if(*codegen_errors)
+                fprintf(stderr, "Error: code generation failed with %d error(s), no machine code written\n", *codegen_errors);
+        }
+    } else {
+        printf("\nCompilation failed with %d error(s)\n", total_errors);
+        if(error_count == 0)
+            error_count = 1;
+    }
+    
+    fclose(yyin);
+    yylex_destroy();
+    sem_cleanup(&sem_analyzer);
+    return error_count;
+}
+
+// -pipeline-csv: compile (or assemble, for .s files) each file, run it on the simulator with
+// the pipeline model attached and print one CSV table for all of them; program output is dropped
+static int pipeline_batch(char **files, int count, CodegenOptions options, const PipelineConfig *config) {
+    int failures = 0;
+    PrintPipelineCsvHeader(stdout);
+    for(int i = 0; i < count; i++) {
+        ObjectImage image;
+        ObjectImageInit(&image);
+        const char *dot = strrchr(files[i], '.');
+        int errors, codegen_errors = 0;
+        if(dot && strcmp(dot, ".s") == 0) {
+            errors = AssembleFile(files[i], &image, NULL) != 0;
+        } else {
+            errors = compile_file(files[i], "MIPS64.s", options, &image, NULL, &codegen_errors);
             free_node(ast_root);
-            return 1;
+            ast_root = NULL;
         }
-        
-        // generate MIPS64 assembly
-        GenerateAssemblyProgram(ast_root, asm_file);
-        fclose(asm_file);
-        
-        // now convert assembly to machine code
-        if(MachineFromAssembly(asm_filename, machine_filename)) {
-            // Machine code generation successful
+        if(errors || codegen_errors) {
+            fprintf(stderr, "Error: %s did not compile, skipped\n", files[i]);
+            failures++;
+        } else {
+            PipelineModel *model = PipelineCreate(config, &image);
+            if(!run_simulator(&image, 0, model, 1, NULL))
+                failures++;
+            PrintPipelineCsv(model, files[i], stdout);
+            PipelineFree(model);
         }
+        ObjectImageFree(&image);
+    }
+    return failures != 0;
+}
 
-        // now interpret the program and display output
-        if(ast_root == NULL) {
-            printf("ast_root is NULL! Cannot interpret.\n");
+// -difftest state: where codegen writes the assembly nobody reads, and the last two outputs
+typedef struct {
+    FILE *asm_sink;
+    char *expected;     // interpreter
+    char *actual;       // simulator
+    int optimize;       // level the last mismatch was seen at
+    int valid;          // the last program compiled
+} DiffContext;
+
+#define DIFFTEST_REPORTS 5          // mismatches minimized and written out
+#define DIFFTEST_MAX_INSTRUCTIONS 1000000
+
+// parse a program held in memory (delimiters, semantics and all); NULL if it has errors
+static Node *parse_string(const char *source) {
+    found_prog_start = 0;
+    found_prog_end = 0;
+    ast_root = NULL;
+    line_num = 1;
+    column_num = 1;
+    sem_init(&sem_analyzer);
+    sem_set_line(&sem_analyzer, 1);
+
+    YY_BUFFER_STATE buffer = yy_scan_string(source);
+    int parse_result = yyparse();
+    yy_delete_buffer(buffer);
+    yylex_destroy();
+
+    int errors = parse_result != 0 || !found_prog_start || !found_prog_end ||
+                 sem_get_error_count(&sem_analyzer) > 0;
+    sem_cleanup(&sem_analyzer);
+    if(errors) {
+        free_node(ast_root);
+        ast_root = NULL;
+    }
+    return ast_root;
+}
+
+// simulator output of the program compiled at one optimization level
+static char *simulate_compiled(Node *program, int optimize, FILE *asm_sink) {
+    ObjectImage image;
+    ObjectImageInit(&image);
+    CodegenOptions options = { NULL };
+    options.optimize = optimize;
+    options.schedule = 1;
+    options.object = &image;
+    rewind(asm_sink);
+    int codegen_errors = GenerateAssemblyProgram(program, asm_sink, &options);
+
+    AsmBuffer out;
+    AsmBufferInit(&out, NULL);
+    SimOptions sim_options = { 0 };
+    sim_options.max_instructions = DIFFTEST_MAX_INSTRUCTIONS;
+    SimResult result;
+    Simulate(&image, &out, &sim_options, &result);
+    ObjectImageFree(&image);
+
+    char *text = AsmBufferDetach(&out, NULL);
+    if(codegen_errors) {
+        // code that did not compile never compares equal
+        char *failed = malloc(strlen(text) + 64);
+        sprintf(failed, "%s[codegen: %d error(s)]", text, codegen_errors);
+        free(text);
+        text = failed;
+    } else if(result.status != SIM_EXIT) {
+        // make sure a fault never compares equal
+        char *faulted = malloc(strlen(text) + 64);
+        sprintf(faulted, "%s[simulator: %s]", text, result.status == SIM_FAULT ? result.fault : "limit");
+        free(text);
+        text = faulted;
+    }
+    AsmBufferFree(&out);
+    return text;
+}
+
+// DiffPredicate: 1 if the interpreter and the simulated code (-O1 or -O0) print different text
+static int difftest_check(void *context, const char *source) {
+    DiffContext *diff = context;
+    Node *program = parse_string(source);
+    diff->valid = program != NULL;
+    if(!program)
+        return 0; // only valid programs count
+
+    int mismatch = 0;
+    char *expected = interpret_program(program);
+    for(int optimize = 1; optimize >= 0 && !mismatch; optimize--) {
+        char *actual = simulate_compiled(program, optimize, diff->asm_sink);
+        if(strcmp(expected, actual) != 0) {
+            mismatch = 1;
+            free(diff->expected);
+            free(diff->actual);
+            diff->expected = strdup(expected);
+            diff->actual = actual;
+            diff->optimize = optimize;
         } else {
-            char *output = interpret_program(ast_root);
-            if(output && strlen(output) > 0) {
-                printf("%s", output);
+            free(actual);
+        }
+    }
+    free(expected);
+    free_node(program);
+    ast_root = NULL;
+    return mismatch;
+}
+
+// print text with control characters made visible
+static void print_escaped(const char *label, const char *text) {
+    printf("  %s \"", label);
+    for(const char *p = text; *p; p++) {
+        if(*p == '\n')
+            printf("\\n");
+        else if(*p == '\t')
+            printf("\\t");
+        else if(*p == '"' || *p == '\\')
+            printf("\\%c", *p);
+        else
+            putchar(*p);
+    }
+    printf("\"\n");
+}
+
+// -difftest: run count random programs on both engines; mismatches are minimized, printed and
+// saved as DIFFTEST_<seed>.p0; 1 if any were found
+static int difftest_run(int count, uint64_t seed, int wide) {
+    DiffContext diff = { NULL };
+    diff.asm_sink = tmpfile();
+    if(!diff.asm_sink) {
+        fprintf(stderr, "Error: Cannot create a temporary file\n");
+        return 1;
+    }
+    DiffGenOptions options;
+    options.statements = DIFFTEST_STATEMENTS;
+    options.wide = wide;
+    options.quiet = 0;
+
+    int mismatches = 0;
+    int invalid = 0;
+    clock_t start = clock();
+    for(int i = 0; i < count; i++) {
+        options.variables = i % DIFFTEST_CROWDED_EVERY == 0 ? DIFFTEST_CROWDED_VARIABLES : 0;
+        char *source = DiffGenerateProgram(seed + i, &options);
+        int mismatch = difftest_check(&diff, source);
+        if(!diff.valid) {
+            // the generator should only write valid programs
+            fprintf(stderr, "Generated program for seed %llu does not compile:\n%s\n", (unsigned long long)(seed + i), source);
+            invalid++;
+        }
+        if(mismatch) {
+            mismatches++;
+            if(mismatches <= DIFFTEST_REPORTS) {
+                char *smallest = DiffMinimize(source, difftest_check, &diff);
+                difftest_check(&diff, smallest); // outputs of the minimized program
+
+                char filename[64];
+                snprintf(filename, sizeof(filename), "DIFFTEST_%llu.p0", (unsigned long long)(seed + i));
+                FILE *saved = fopen(filename, "w");
+                if(saved) {
+                    fputs(smallest, saved);
+                    fclose(saved);
+                }
+                printf("Mismatch for seed %llu at -O%d, minimized to %s:\n%s\n",
+                       (unsigned long long)(seed + i), diff.optimize, filename, smallest);
+                print_escaped("interpreter", diff.expected);
+                print_escaped("simulator  ", diff.actual);
+                free(smallest);
+            }
+        }
+        free(source);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("difftest: %d programs, %d mismatches, %d invalid, %.2f s (%.0f programs/s)\n", count, mismatches,
+           invalid, seconds, seconds > 0 ? count / seconds : 0.0);
+
+    fclose(diff.asm_sink);
+    free(diff.expected);
+    free(diff.actual);
+    return mismatches != 0 || invalid != 0;
+}
+
+#define INTERP_BENCH_STATEMENTS 5000
+#define INTERP_BENCH_RUNS 20
+
+// -interp-bench: time the tree walker against the bytecode VM, with and without superinstructions
+// on count generated programs, each run INTERP_BENCH_RUNS times (prepared once); 1 if the
+// outputs ever differ
+static int interp_bench(int count, int statements, uint64_t seed) {
+    DiffGenOptions options;
+    options.statements = statements;
+    options.wide = 0;
+    options.quiet = 1;
+    options.variables = 0;
+
+    double resolve_seconds = 0, tree_seconds = 0, compile_seconds = 0, vm_seconds = 0, unfused_seconds = 0;
+    long long dispatches = 0, unfused_dispatches = 0;
+    double jit_compile_seconds = 0, jit_seconds = 0;
+    size_t jit_bytes = 0;
+    int jit = jit_available();
+    long long output_bytes = 0;
+    int differ = 0, invalid = 0;
+    for(int i = 0; i < count; i++) {
+        char *source = DiffGenerateProgram(seed + i, &options);
+        Node *program = parse_string(source);
+        free(source);
+        if(!program) {
+            invalid++;
+            continue;
+        }
+        // both engines prepare once: the tree walker numbers the variables, the VM compiles
+        clock_t start = clock();
+        int slot_count = resolve_slots(program, NULL);
+        resolve_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        OutputCapture tree;
+        capture_init(&tree);
+        start = clock();
+        for(int run = 0; run < INTERP_BENCH_RUNS; run++) {
+            capture_free(&tree);
+            capture_init(&tree);
+            interpret_tree_resolved(program, slot_count, &tree);
+        }
+        tree_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        Bytecode *bytecode = bytecode_compile(program);
+        compile_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        OutputCapture vm;
+        capture_init(&vm);
+        start = clock();
+        for(int run = 0; run < INTERP_BENCH_RUNS; run++) {
+            capture_free(&vm);
+            capture_init(&vm);
+            bytecode_run(bytecode, &vm);
+        }
+        vm_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        dispatches += bytecode_dispatch_count(bytecode);
+
+        // the same VM on code without superinstructions
+        Bytecode *unfused = bytecode_compile_unfused(program);
+        OutputCapture plain;
+        capture_init(&plain);
+        start = clock();
+        for(int run = 0; run < INTERP_BENCH_RUNS; run++) {
+            capture_free(&plain);
+            capture_init(&plain);
+            bytecode_run(unfused, &plain);
+        }
+        unfused_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        unfused_dispatches += bytecode_dispatch_count(unfused);
+        bytecode_free(unfused);
+
+        OutputCapture native;
+        capture_init(&native);
+        if(jit) {
+            start = clock();
+            JitProgram *code = jit_compile(program);
+            jit_compile_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+            if(code) {
+                jit_bytes += jit_code_size(code);
+                start = clock();
+                for(int run = 0; run < INTERP_BENCH_RUNS; run++) {
+                    capture_free(&native);
+                    capture_init(&native);
+                    jit_run(code, &native);
+                }
+                jit_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+                jit_free(code);
             } else {
-                printf("(No output produced)\n");
+                jit = 0; // no executable memory
             }
-            free(output);
         }
-        
+
+        if(strcmp(capture_get(&tree), capture_get(&vm)) != 0 || strcmp(capture_get(&tree), capture_get(&plain)) != 0 ||
+           (jit && strcmp(capture_get(&tree), capture_get(&native)) != 0)) {
+            fprintf(stderr, "Engines disagree on the program for seed %llu\n", (unsigned long long)(seed + i));
+            differ++;
+        }
+        output_bytes += tree.size;
+        capture_free(&tree);
+        capture_free(&vm);
+        capture_free(&plain);
+        capture_free(&native);
+        bytecode_free(bytecode);
+        free_node(program);
+        ast_root = NULL;
+    }
+    long long executed = (long long)(count - invalid) * statements * INTERP_BENCH_RUNS;
+    printf("interp-bench: %d programs of %d statements run %d times, %lld bytes of output per run, %d differ, %d invalid\n",
+           count, statements, INTERP_BENCH_RUNS, output_bytes, differ, invalid);
+    printf("  tree walker  %.3f s (%.1f M statements/s) + %.3f s numbering variables\n", tree_seconds,
+           tree_seconds > 0 ? executed / tree_seconds / 1e6 : 0.0, resolve_seconds);
+    printf("  bytecode VM  %.3f s (%.1f M statements/s) + %.3f s compiling\n", vm_seconds,
+           vm_seconds > 0 ? executed / vm_seconds / 1e6 : 0.0, compile_seconds);
+    printf("  speedup %.2fx, %.2fx with the preparation\n", vm_seconds > 0 ? tree_seconds / vm_seconds : 0.0,
+           vm_seconds + compile_seconds > 0 ? (tree_seconds + resolve_seconds) / (vm_seconds + compile_seconds) : 0.0);
+    printf("  superinstructions: %.2f dispatches per statement instead of %.2f, %.3f s without them, speedup %.2fx\n",
+           executed ? (double)dispatches * INTERP_BENCH_RUNS / executed : 0.0,
+           executed ? (double)unfused_dispatches * INTERP_BENCH_RUNS / executed : 0.0, unfused_seconds,
+           vm_seconds > 0 ? unfused_seconds / vm_seconds : 0.0);
+    if(jit) {
+        printf("  x86-64 JIT   %.3f s (%.1f M statements/s) + %.3f s compiling, %zu bytes of code\n", jit_seconds,
+               jit_seconds > 0 ? executed / jit_seconds / 1e6 : 0.0, jit_compile_seconds, jit_bytes);
+        printf("  speedup over the VM %.2fx, %.2fx with the preparation\n", jit_seconds > 0 ? vm_seconds / jit_seconds : 0.0,
+               jit_seconds + jit_compile_seconds > 0 ? (vm_seconds + compile_seconds) / (jit_seconds + jit_compile_seconds) : 0.0);
     } else {
-        printf("\nCompilation failed with %d error(s)\n", total_errors);
+        printf("  x86-64 JIT   not available on this machine\n");
+    }
+    return differ != 0 || invalid != 0;
+}
+
+// -output-bench: append count print items (numbers, strings and newlines in the mix a report
+// prints) to an OutputCapture: formatted with capture_printf, then written directly (numbers
+// by capture_int, strings by stored length), in memory and streaming to a file
+static int output_bench(long long count) {
+    static const char *const modes[] = { "printf", "direct", "direct, streamed" };
+    static const char label[] = " = ";
+    FILE *file = tmpfile();
+    if(!file) {
+        fprintf(stderr, "Error: Cannot create a temporary file\n");
+        return 1;
+    }
+    int failed = 0;
+    double printf_seconds = 0;
+    for(int mode = 0; mode < 3; mode++) {
+        OutputCapture out;
+        capture_init_sink(&out, mode == 2 ? file : NULL, 0);
+        clock_t start = clock();
+        for(long long i = 0; i < count; i++) {
+            int number = (int)(i * 2654435761u) >> (i % 31); // all lengths and signs
+            if(mode == 0) {
+                switch(i % 4) {
+                    case 0: case 2: capture_printf(&out, "%d", number); break;
+                    case 1: capture_printf(&out, "%s", label); break;
+                    default: capture_printf(&out, "\n"); break;
+                }
+            } else {
+                switch(i % 4) {
+                    case 0: case 2: capture_int(&out, number); break;
+                    case 1: capture_append(&out, label, sizeof(label) - 1); break;
+                    default: capture_append(&out, "\n", 1); break;
+                }
+            }
+        }
+        capture_flush(&out);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if(mode == 0)
+            printf_seconds = seconds;
+        size_t total = out.flushed + out.size;
+        size_t expected = mode == 2 ? (size_t)ftell(file) : strlen(capture_get(&out));
+        failed |= total != expected;
+        printf("output-bench (%s): %lld items, %zu bytes, %zu byte buffer, %.3f s (%.1f M items/s, %.2fx)%s\n",
+               modes[mode], count, total, out.capacity, seconds, seconds > 0 ? count / seconds / 1e6 : 0.0,
+               seconds > 0 ? printf_seconds / seconds : 0.0, total == expected ? "" : ", size is wrong");
+        capture_free(&out);
     }
+    fclose(file);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    char *source_filename = NULL;
+    char *asm_filename = "MIPS64.s";
+    char *machine_stem = "MACHINE_CODE";
+    int optimize = 1;
+    int schedule = 1;
+    int report_stalls = 0;
+    int assemble_only = 0;
+    int list_only = 0;
+    int report_layout = 0;
+    int listing = 1;
+    int elf = 0;
+    int simulate = 0;
+    int simulate_report = 0;
+    int pipeline = 0;
+    int pipeline_csv = 0;
+    int difftest = 0;
+    uint64_t difftest_seed = 1;
+    int difftest_wide = 0;
+    int interp_tree = 0;
+    int use_jit = 0;
+    int emit_c = 0;
+    int native = 0;
+    int stats_mode = 0; // 1: table on stderr, 2: JSON on stderr
+    int bench = 0;
+    int bench_statements = INTERP_BENCH_STATEMENTS;
+    long long output_items = 0;
+    PipelineConfig pipeline_config;
+    PipelineDefaultConfig(&pipeline_config);
     
-    fclose(yyin);
-    yylex_destroy();
-    sem_cleanup(&sem_analyzer);
+    // compiler [-O0|-O1] [-no-schedule] [-stalls] [-elf] [-no-listing] [-sim|-sim-report] [pipeline options] source [assembly]
+    // compiler -assemble [-layout] [-elf] [-no-listing] [-sim|-sim-report] [pipeline options] assembly [machine_code]
+    // compiler -list binary [listing]
+    // compiler -pipeline-csv [-O0|-O1] [-no-schedule] [pipeline options] file...
+    // pipeline options: -pipeline [-no-forwarding] [-mult-latency n] [-div-latency n]
+    // compiler -difftest count [-difftest-seed n] [-difftest-wide]
+    // compiler -interp-bench count [-interp-bench-statements n] [-difftest-seed n]
+    // compiler -output-bench count
+    // -interp-tree: interpret by walking the AST instead of on the bytecode VM
+    // -jit: run the program as x86-64 machine code instead of on the bytecode VM
+    // -emit-c: also write the program as C (NATIVE.c); -native: and build it with cc -O2 (./NATIVE)
+    // -stats (--stats): time, allocations and peak RSS of each phase on stderr; -stats-json: as JSON
+    char **files = malloc(sizeof(char *) * argc);
+    int positional = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-O0") == 0) {
+            optimize = 0;
+        } else if(strcmp(argv[i], "-O1") == 0) {
+            optimize = 1;
+        } else if(strcmp(argv[i], "-no-schedule") == 0) {
+            schedule = 0;
+        } else if(strcmp(argv[i], "-stalls") == 0) {
+            report_stalls = 1;
+        } else if(strcmp(argv[i], "-assemble") == 0) {
+            assemble_only = 1;
+        } else if(strcmp(argv[i], "-layout") == 0) {
+            report_layout = 1;
+        } else if(strcmp(argv[i], "-list") == 0) {
+            list_only = 1;
+        } else if(strcmp(argv[i], "-elf") == 0) {
+            elf = 1;
+        } else if(strcmp(argv[i], "-no-listing") == 0) {
+            listing = 0;
+        } else if(strcmp(argv[i], "-sim") == 0) {
+            simulate = 1;
+        } else if(strcmp(argv[i], "-sim-report") == 0) {
+            simulate = 1;
+            simulate_report = 1;
+        } else if(strcmp(argv[i], "-pipeline") == 0) {
+            // cycle counts come from the simulated run
+            simulate = 1;
+            pipeline = 1;
+        } else if(strcmp(argv[i], "-pipeline-csv") == 0) {
+            pipeline_csv = 1;
+        } else if(strcmp(argv[i], "-no-forwarding") == 0) {
+            pipeline_config.forwarding = 0;
+        } else if(strcmp(argv[i], "-mult-latency") == 0 && i + 1 < argc) {
+            pipeline_config.mult_latency = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-div-latency") == 0 && i + 1 < argc) {
+            pipeline_config.div_latency = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-difftest") == 0 && i + 1 < argc) {
+            difftest = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-difftest-seed") == 0 && i + 1 < argc) {
+            difftest_seed = strtoull(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-difftest-wide") == 0) {
+            difftest_wide = 1;
+        } else if(strcmp(argv[i], "-interp-tree") == 0) {
+            interp_tree = 1;
+        } else if(strcmp(argv[i], "-jit") == 0) {
+            use_jit = 1;
+        } else if(strcmp(argv[i], "-emit-c") == 0) {
+            emit_c = 1;
+        } else if(strcmp(argv[i], "-stats") == 0 || strcmp(argv[i], "--stats") == 0) {
+            stats_mode = 1;
+        } else if(strcmp(argv[i], "-stats-json") == 0 || strcmp(argv[i], "--stats-json") == 0) {
+            stats_mode = 2;
+        } else if(strcmp(argv[i], "-native") == 0) {
+            emit_c = 1;
+            native = 1;
+        } else if(strcmp(argv[i], "-interp-bench") == 0 && i + 1 < argc) {
+            bench = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-interp-bench-statements") == 0 && i + 1 < argc) {
+            bench_statements = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-output-bench") == 0 && i + 1 < argc) {
+            output_items = atoll(argv[++i]);
+        } else {
+            files[positional++] = argv[i];
+        }
+    }
+    if(difftest > 0) {
+        free(files);
+        return difftest_run(difftest, difftest_seed, difftest_wide);
+    }
+    if(bench > 0) {
+        free(files);
+        return interp_bench(bench, bench_statements, difftest_seed);
+    }
+    if(output_items > 0) {
+        free(files);
+        return output_bench(output_items);
+    }
+    if(positional >= 1)
+        source_filename = files[0];
+    if(positional >= 2)
+        asm_filename = files[1];
+    if(!source_filename) {
+        fprintf(stderr, "Usage: %s [-O0|-O1] [-no-schedule] [-stalls] [-elf] [-no-listing] [-emit-c|-native] [-stats|-stats-json] [-sim|-sim-report|-interp-tree|-jit] [pipeline options] source [assembly]\n", argv[0]);
+        fprintf(stderr, "       %s -assemble [-layout] [-elf] [-no-listing] [-sim|-sim-report] [pipeline options] assembly [machine_code]\n", argv[0]);
+        fprintf(stderr, "       %s -list binary [listing]\n", argv[0]);
+        fprintf(stderr, "       %s -pipeline-csv [-O0|-O1] [-no-schedule] [pipeline options] file...\n", argv[0]);
+        fprintf(stderr, "       %s -difftest count [-difftest-seed n] [-difftest-wide]\n", argv[0]);
+        fprintf(stderr, "       %s -interp-bench count [-interp-bench-statements n] [-difftest-seed n]\n", argv[0]);
+        fprintf(stderr, "       %s -output-bench count\n", argv[0]);
+        fprintf(stderr, "pipeline options: -pipeline [-no-forwarding] [-mult-latency n] [-div-latency n]\n");
+        free(files);
+        return 1;
+    }
+
+    CodegenOptions codegen_options = { NULL };
+    codegen_options.optimize = optimize;
+    codegen_options.schedule = schedule;
+    codegen_options.stall_report = report_stalls ? stderr : NULL;
+
+    if(pipeline_csv) {
+        int failed = pipeline_batch(files, positional, codegen_options, &pipeline_config);
+        free(files);
+        return failed;
+    }
+    free(files);
+    
+    if(list_only) {
+        // text view of a raw binary
+        FILE *out = positional >= 2 ? fopen(asm_filename, "w") : stdout;
+        int ok = out && ListRawBinary(source_filename, out);
+        if(!ok)
+            fprintf(stderr, "Error: Cannot list %s\n", source_filename);
+        if(out && out != stdout)
+            fclose(out);
+        return !ok;
+    }
+    
+    if(assemble_only) {
+        // standalone two-pass assembler
+        ObjectImage image;
+        ObjectImageInit(&image);
+        int asm_errors = AssembleFile(source_filename, &image, report_layout ? stdout : NULL);
+        if(asm_errors < 0)
+            fprintf(stderr, "Error: Cannot assemble %s\n", source_filename);
+        else if(asm_errors > 0)
+            fprintf(stderr, "%d error(s) in %s\n", asm_errors, source_filename);
+        else {
+            char *stem = output_name(positional >= 2 ? asm_filename : machine_stem, ".mc", "");
+            write_object_files(&image, stem, listing, elf);
+            free(stem);
+            if(simulate) {
+                PipelineModel *model = pipeline ? PipelineCreate(&pipeline_config, &image) : NULL;
+                if(!run_simulator(&image, simulate_report, model, 0, NULL))
+                    asm_errors = 1;
+                if(model)
+                    PrintPipelineReport(model, stderr);
+                PipelineFree(model);
+            }
+        }
+        ObjectImageFree(&image);
+        return asm_errors != 0;
+    }
+    
+    if(positional >= 2) {
+        // machine code files are named after the assembly file
+        machine_stem = output_name(asm_filename, ".s", "");
+    }
+    
+    Stats stats;
+    stats_init(&stats);
+    Stats *phases = stats_mode ? &stats : NULL;
+    ObjectImage image;
+    ObjectImageInit(&image);
+    int codegen_errors;
+    int errors = compile_file(source_filename, asm_filename, codegen_options, &image, phases, &codegen_errors);
+    if(errors == 0) {
+        // a backend failure only costs the machine code; the program still runs interpreted
+        if(codegen_errors == 0) {
+            stats_begin(phases, "object-files");
+            write_object_files(&image, machine_stem, listing, elf);
+            stats_end(phases);
+        }
+        if(emit_c) {
+            stats_begin(phases, native ? "native" : "emit-c");
+            if(!write_native_program(ast_root, native))
+                errors = 1;
+            stats_end(phases);
+        }
+
+        // now run the program and display output: the machine code on the simulator,
+        // or by default the interpreter
+        if(simulate && codegen_errors) {
+            fprintf(stderr, "Error: no machine code to simulate\n");
+        } else if(simulate) {
+            PipelineModel *model = pipeline ? PipelineCreate(&pipeline_config, &image) : NULL;
+            stats_begin(phases, "run");
+            if(!run_simulator(&image, simulate_report, model, 0, &stats.output_bytes))
+                errors = 1;
+            stats_end(phases);
+            if(model)
+                PrintPipelineReport(model, stderr);
+            PipelineFree(model);
+        } else if(ast_root == NULL) {
+            printf("ast_root is NULL! Cannot interpret.\n");
+        } else {
+            // streamed to stdout as the program prints: line by line to a terminal, in
+            // chunks to a file or pipe
+            OutputCapture output;
+            fflush(stdout);
+            capture_init_sink(&output, stdout, isatty(fileno(stdout)));
+            stats_begin(phases, "run");
+            if(interp_tree)
+                interpret_tree_into(ast_root, &output);
+            else if(use_jit) {
+                if(!interpret_jit_into(ast_root, &output))
+                    fprintf(stderr, "Note: the JIT is not available here, ran on the bytecode VM\n");
+            } else
+                interpret_into(ast_root, &output);
+            capture_flush(&output);
+            stats_end(phases);
+            stats.output_bytes = output.flushed;
+            if(output.flushed == 0) {
+                printf("(No output produced)\n");
+            }
+            capture_free(&output);
+        }
+    }
+    if(stats_mode) {
+        fflush(stdout);
+        if(stats_mode == 2)
+            stats_print_json(&stats, stderr);
+        else
+            stats_print(&stats, stderr);
+    }
+    ObjectImageFree(&image);
     free_node(ast_root);
     
-    return (parse_result != 0 || error_count > 0) ? 1 : 0;
+    return errors != 0 || codegen_errors != 0;
 }
 void yyerror(const char *s) {
     //fprintf(stderr, "Syntax error at line %d: %s\n", sem_analyzer.current_line, s);
@@ -2384,9 +3171,11 @@ void yyerror(const char *s) {
 }
 
 // AST Creation Functions - UPDATED FOR NEW STRUCTURE
-Node *create_num_node(int val) {
+Node *create_num_node(long long val) {
     Node *node = malloc(sizeof(Node));
     node->node_type = 0;
+    node->line = sem_analyzer.current_line;
+    node->slot = -1;
     node->next = NULL;
     node->int_val = val;
     return node;
@@ -2395,8 +3184,11 @@ Node *create_num_node(int val) {
 Node *create_str_node(char *str) {
     Node *node = malloc(sizeof(Node));
     node->node_type = 1;
+    node->line = sem_analyzer.current_line;
+    node->slot = -1;
     node->next = NULL;
     node->str_val = strdup(str);
+    node->str_len = strlen(str);
     return node;
 }
 
@@ -2406,6 +3198,8 @@ Node *create_id_node(char *name) {
         return NULL;
     }
     node->node_type = 2;
+    node->line = sem_analyzer.current_line;
+    node->slot = -1;
     node->next = NULL;
     node->str_val = strdup(name);
     if(!node->str_val) {
@@ -2421,6 +3215,7 @@ Node *create_binop_node(int op, Node *left, Node *right) {
         return NULL;
     }
     node->node_type = 3;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->binop.op = op;
     node->binop.left = left;
@@ -2434,6 +3229,7 @@ Node *create_decl_node(Node *items) {
         return NULL;
     }
     node->node_type = 4;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->decl_assign.items = items;  // decl_assign.items instead of list.items
     return node;
@@ -2445,6 +3241,7 @@ Node *create_assign_node(Node *items) {
         return NULL;
     }
     node->node_type = 5;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->decl_assign.items = items;  // decl_assign.items instead of list.items
     return node;
@@ -2456,6 +3253,7 @@ Node *create_print_node(Node *parts) {
         return NULL;
     }
     node->node_type = 6;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->print_stmt.parts = parts;
     return node;
@@ -2467,6 +3265,7 @@ Node *create_print_part_node(Node *content) {
         return NULL;
     }
     node->node_type = NODE_PRINT_PART;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->print_part.items = content;  // print_part.items instead of list.items
     node->print_part.part_next = NULL;  // For chaining print parts
@@ -2479,6 +3278,7 @@ Node *create_str_assign_node(Node *id_node, Node *str_node) {
         return NULL;
     }
     node->node_type = NODE_STR_ASSIGN;
+    node->line = sem_analyzer.current_line;
     node->next = NULL;
     node->str_assign.id = id_node;
     node->str_assign.str = str_node;
@@ -74,9 +74,9 @@ extern int yydebug;
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 union YYSTYPE
 {
-#line 51 "parser.y"
+#line 77 "parser.y"
 
-    int int_val;
+    long long int_val;
     char *str_val;
     void *node_ptr;
 
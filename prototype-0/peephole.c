@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "peephole.h"
+
+// which register currently holds the in-memory value of a variable
+typedef struct {
+    const char *name;
+    int reg;
+} KnownValue;
+
+typedef struct {
+    KnownValue *items;
+    int count;
+    int capacity;
+} KnownValues;
+
+static KnownValue *FindKnown(KnownValues *known, const char *name) {
+    for(int i = 0; i < known->count; i++) {
+        if(strcmp(known->items[i].name, name) == 0)
+            return &known->items[i];
+    }
+    return NULL;
+}
+
+static void SetKnown(KnownValues *known, const char *name, int reg) {
+    KnownValue *kv = FindKnown(known, name);
+    if(!kv) {
+        if(known->count >= known->capacity) {
+            known->capacity = known->capacity ? known->capacity * 2 : 16;
+            known->items = realloc(known->items, sizeof(KnownValue) * known->capacity);
+        }
+        kv = &known->items[known->count++];
+        kv->name = name;
+    }
+    kv->reg = reg;
+}
+
+// reg was overwritten: nothing it held is valid anymore
+static void ForgetRegister(KnownValues *known, int reg) {
+    for(int i = 0; i < known->count; i++) {
+        if(known->items[i].reg == reg)
+            known->items[i].reg = -1;
+    }
+}
+
+static void ForgetAll(KnownValues *known) {
+    for(int i = 0; i < known->count; i++) {
+        known->items[i].reg = -1;
+    }
+}
+
+// ld/sd on a plain label, i.e. "x(r0)"; anything else has an unknown address
+static int IsDirectAccess(const Instruction *ins) {
+    return ins->symbol && ins->rs == 0;
+}
+
+// syscalls 1 (print int) and 11 (print char) only look at r4, the rest may read memory
+static int SyscallReadsMemory(const Instruction *ins) {
+    return ins->imm != 1 && ins->imm != 11;
+}
+
+// turn "sd r4, x(r0)" ... "ld r10, x(r0)" into a register move (or nothing)
+static void ForwardStoresToLoads(InstructionList *code) {
+    KnownValues known = { NULL, 0, 0 };
+
+    for(int i = 0; i < code->count; i++) {
+        Instruction *ins = &code->items[i];
+
+        if(ins->op == INS_LD && IsDirectAccess(ins)) {
+            KnownValue *kv = FindKnown(&known, ins->symbol);
+            if(kv && kv->reg == ins->rt) {
+                // value is already in the destination register
+                ins->op = INS_NOP;
+                continue;
+            }
+            if(kv && kv->reg != -1) {
+                // forward from the register that holds it: daddu rt, reg, r0
+                int src = kv->reg;
+                int dst = ins->rt;
+                free(ins->symbol);
+                ins->symbol = NULL;
+                ins->op = INS_DADDU;
+                ins->rd = dst;
+                ins->rs = src;
+                ins->rt = 0;
+                ForgetRegister(&known, dst);
+                continue;
+            }
+            ForgetRegister(&known, ins->rt);
+            SetKnown(&known, ins->symbol, ins->rt);
+        } else if(ins->op == INS_SD && IsDirectAccess(ins)) {
+            SetKnown(&known, ins->symbol, ins->rt);
+        } else if(ins->op == INS_SD) {
+            ForgetAll(&known); // store through a base register may hit anything
+        } else {
+            int def = InstructionDef(ins);
+            if(def > 0)
+                ForgetRegister(&known, def);
+        }
+    }
+
+    free(known.items);
+}
+
+static void ReplaceUse(Instruction *ins, int from, int to) {
+    switch(ins->op) {
+        case INS_DADDIU:
+        case INS_LD:
+        case INS_ORI:
+            if(ins->rs == from) ins->rs = to;
+            break;
+        case INS_DSLL:
+            if(ins->rt == from) ins->rt = to;
+            break;
+        case INS_DADDU:
+        case INS_DSUBU:
+        case INS_SLTU:
+        case INS_DMULT:
+        case INS_DDIV:
+        case INS_SD:
+            if(ins->rs == from) ins->rs = to;
+            if(ins->rt == from) ins->rt = to;
+            break;
+        default:
+            break;
+    }
+}
+
+// "daddu rd, rs, r0": read rs instead of rd downstream and drop the move if possible
+static void PropagateCopies(InstructionList *code) {
+    for(int i = 0; i < code->count; i++) {
+        Instruction *move = &code->items[i];
+        if(move->op != INS_DADDU || move->rt != 0 || move->rd == move->rs)
+            continue;
+
+        int dst = move->rd;
+        int src = move->rs;
+        int removable = 1;
+        int src_clobbered = 0;
+
+        for(int j = i + 1; j < code->count; j++) {
+            Instruction *ins = &code->items[j];
+            int uses[3];
+            int n = InstructionUses(ins, uses);
+            int reads_dst = 0;
+            for(int k = 0; k < n; k++) {
+                if(uses[k] == dst)
+                    reads_dst = 1;
+            }
+
+            if(reads_dst) {
+                if(src_clobbered || ins->op == INS_SYSCALL) {
+                    removable = 0; // dst is still needed here
+                    break;
+                }
+                ReplaceUse(ins, dst, src);
+            }
+
+            int def = InstructionDef(ins);
+            if(def == dst)
+                break; // dst is dead from here on
+            if(def == src)
+                src_clobbered = 1;
+        }
+
+        if(removable)
+            move->op = INS_NOP;
+    }
+}
+
+// walk backwards; a store is dead if the same variable is stored again before any read
+static void RemoveDeadStores(InstructionList *code) {
+    const char **overwritten = malloc(sizeof(char*) * (code->count + 1));
+    int count = 0;
+
+    for(int i = code->count - 1; i >= 0; i--) {
+        Instruction *ins = &code->items[i];
+
+        if(ins->op == INS_SD && IsDirectAccess(ins)) {
+            int dead = 0;
+            for(int k = 0; k < count; k++) {
+                if(strcmp(overwritten[k], ins->symbol) == 0) {
+                    dead = 1;
+                    break;
+                }
+            }
+            if(dead)
+                ins->op = INS_NOP;
+            else
+                overwritten[count++] = ins->symbol;
+        } else if(ins->op == INS_LD && IsDirectAccess(ins)) {
+            for(int k = 0; k < count; k++) {
+                if(strcmp(overwritten[k], ins->symbol) == 0) {
+                    overwritten[k] = overwritten[--count];
+                    break;
+                }
+            }
+        } else if(ins->op == INS_LD || (ins->op == INS_SYSCALL && SyscallReadsMemory(ins))) {
+            count = 0; // unknown read, every pending store is live again
+        }
+    }
+
+    free(overwritten);
+}
+
+void OptimizeLoadsAndStores(InstructionList *code) {
+    if(!code || code->count == 0)
+        return;
+
+    ForwardStoresToLoads(code);
+    PropagateCopies(code);
+    RemoveDeadStores(code);
+    CompactInstructionList(code);
+}
@@ -0,0 +1,10 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "instruction.h"
+
+// store-to-load forwarding, redundant load removal and dead store elimination
+// over the straight-line .code stream
+void OptimizeLoadsAndStores(InstructionList *code);
+
+#endif
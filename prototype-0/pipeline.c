@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pipeline.h"
+#include "machine_code.h"
+
+// HI/LO tracked as one extra register
+#define REG_HILO 32
+#define REG_COUNT 33
+
+// EX units; each takes one instruction at a time
+typedef enum {
+    UNIT_INT = 0,
+    UNIT_MULT,
+    UNIT_DIV,
+    UNIT_COUNT
+} Unit;
+
+// stage in which a source operand is needed
+typedef enum {
+    READ_EX = 0,
+    READ_ID,     // branches compare in ID
+    READ_MEM     // the value sd stores
+} ReadStage;
+
+// what the timing needs to know about one code word
+typedef struct {
+    int8_t src[3];
+    uint8_t src_stage[3];
+    int8_t src_count;
+    int8_t dest;         // -1 if none
+    uint8_t unit;
+    uint8_t is_load;
+    uint8_t is_branch;   // beq, bne, j
+} PipeInstr;
+
+// MEM reservations are kept for this many cycles ahead (a power of two)
+#define MEM_RING 256
+
+struct PipelineModel {
+    PipelineConfig config;
+    PipeInstr *instrs;
+    const int *lines;
+    int code_count;
+
+    PipelineCounts *by_line;
+    int line_count;
+    PipelineCounts total;
+
+    // timing of the previous instruction
+    int started;
+    int prev_index;
+    long long prev_if, prev_id, prev_ex;
+    // when each register's newest value can be used (with forwarding: entering EX;
+    // without: ID has to end after its WB) and when it is written back
+    long long ready[REG_COUNT];
+    long long written[REG_COUNT];
+    long long unit_free[UNIT_COUNT];
+    long long mem_ring[MEM_RING];
+    long long last_wb;
+};
+
+void PipelineDefaultConfig(PipelineConfig *config) {
+    config->forwarding = 1;
+    config->mult_latency = PIPELINE_MULT_LATENCY;
+    config->div_latency = PIPELINE_DIV_LATENCY;
+}
+
+static void AddSource(PipeInstr *p, int reg, ReadStage stage) {
+    if(reg == 0)
+        return; // r0 is never waited for
+    p->src[p->src_count] = reg;
+    p->src_stage[p->src_count++] = stage;
+}
+
+static void DecodeForTiming(uint32_t w, PipeInstr *p) {
+    int rs = (w >> 21) & 31, rt = (w >> 16) & 31, rd = (w >> 11) & 31;
+    memset(p, 0, sizeof(*p));
+    p->dest = -1;
+    switch(w >> 26) {
+        case 0:
+            switch(w & 0x3F) {
+                case FUNCT_DADDU:
+                case FUNCT_DSUBU:
+                case FUNCT_SLTU:
+                    AddSource(p, rs, READ_EX);
+                    AddSource(p, rt, READ_EX);
+                    p->dest = rd;
+                    break;
+                case FUNCT_DMULT + 4:
+                case FUNCT_DDIV + 4:
+                    AddSource(p, rs, READ_EX);
+                    AddSource(p, rt, READ_EX);
+                    p->dest = REG_HILO;
+                    p->unit = (w & 0x3F) == FUNCT_DMULT + 4 ? UNIT_MULT : UNIT_DIV;
+                    break;
+                case FUNCT_DSLL:
+                    AddSource(p, rt, READ_EX);
+                    p->dest = rd;
+                    break;
+                case FUNCT_MFLO:
+                case FUNCT_MFHI:
+                    AddSource(p, REG_HILO, READ_EX);
+                    p->dest = rd;
+                    break;
+                case FUNCT_SYSCALL:
+                    // the argument, and the printf block pointer for syscall 5
+                    AddSource(p, ((w >> 6) & 0xFFFFF) == 5 ? 14 : 4, READ_EX);
+                    break;
+            }
+            break;
+        case OP_DADDIU:
+        case OP_ORI:
+            AddSource(p, rs, READ_EX);
+            p->dest = rt;
+            break;
+        case OP_LUI:
+            p->dest = rt;
+            break;
+        case OP_LD:
+            AddSource(p, rs, READ_EX);
+            p->dest = rt;
+            p->is_load = 1;
+            break;
+        case OP_SD:
+            AddSource(p, rs, READ_EX);
+            AddSource(p, rt, READ_MEM);
+            break;
+        case OP_BEQ:
+        case OP_BNE:
+            AddSource(p, rs, READ_ID);
+            AddSource(p, rt, READ_ID);
+            p->is_branch = 1;
+            break;
+        case OP_J:
+            p->is_branch = 1;
+            break;
+    }
+    if(p->dest == 0)
+        p->dest = -1;
+}
+
+static int ClampLatency(int cycles) {
+    if(cycles < 1)
+        return 1;
+    return cycles > PIPELINE_MAX_LATENCY ? PIPELINE_MAX_LATENCY : cycles;
+}
+
+PipelineModel *PipelineCreate(const PipelineConfig *config, const ObjectImage *image) {
+    PipelineModel *m = calloc(1, sizeof(PipelineModel));
+    m->config = *config;
+    m->config.mult_latency = ClampLatency(config->mult_latency);
+    m->config.div_latency = ClampLatency(config->div_latency);
+    m->code_count = image->code_count;
+    m->lines = image->lines;
+    m->instrs = malloc(sizeof(PipeInstr) * (image->code_count ? image->code_count : 1));
+
+    int max_line = 0;
+    for(int i = 0; i < image->code_count; i++) {
+        DecodeForTiming(image->code[i], &m->instrs[i]);
+        if(image->lines && image->lines[i] > max_line)
+            max_line = image->lines[i];
+    }
+    m->line_count = max_line + 1;
+    m->by_line = calloc(m->line_count, sizeof(PipelineCounts));
+    for(int i = 0; i < MEM_RING; i++) {
+        m->mem_ring[i] = -1;
+    }
+    return m;
+}
+
+void PipelineFree(PipelineModel *model) {
+    if(!model)
+        return;
+    free(model->instrs);
+    free(model->by_line);
+    free(model);
+}
+
+static PipelineCounts *LineOf(PipelineModel *m, int index) {
+    int line = m->lines ? m->lines[index] : 0;
+    return &m->by_line[line >= 0 && line < m->line_count ? line : 0];
+}
+
+// first cycle from c on with MEM free, now taken
+static long long ReserveMem(PipelineModel *m, long long c) {
+    while(m->mem_ring[c & (MEM_RING - 1)] == c)
+        c++;
+    m->mem_ring[c & (MEM_RING - 1)] = c;
+    return c;
+}
+
+// earliest EX start that satisfies one source operand
+static long long OperandReady(const PipelineModel *m, int reg, ReadStage stage) {
+    if(!m->config.forwarding)
+        return m->written[reg] + 1; // registers are read at the end of ID, after the WB write
+    switch(stage) {
+        case READ_ID:
+            return m->ready[reg] + 1;  // compared during the last ID cycle
+        case READ_MEM:
+            return m->ready[reg] - 1;  // needed one stage later
+        default:
+            return m->ready[reg];
+    }
+}
+
+void PipelineStep(void *context, int index) {
+    PipelineModel *m = context;
+    if(index < 0 || index >= m->code_count)
+        return;
+    const PipeInstr *p = &m->instrs[index];
+    PipelineCounts *line = LineOf(m, index);
+
+    // fetch: behind the previous instruction, or after a taken branch resolves in ID
+    long long if_cycle = 0, id_cycle = 1;
+    long long base;
+    if(m->started) {
+        int taken = m->instrs[m->prev_index].is_branch && index != m->prev_index + 1;
+        if(taken) {
+            if_cycle = m->prev_ex;
+            LineOf(m, m->prev_index)->branch++;
+            m->total.branch++;
+        } else {
+            if_cycle = m->prev_if + 1 > m->prev_id ? m->prev_if + 1 : m->prev_id;
+        }
+        id_cycle = if_cycle + 1 > m->prev_ex ? if_cycle + 1 : m->prev_ex;
+    }
+    base = id_cycle + 1;
+
+    // EX start: unit free, then operands, then write-after-write order
+    long long ex = base;
+    if(m->unit_free[p->unit] > ex) {
+        line->structural += m->unit_free[p->unit] - ex;
+        m->total.structural += m->unit_free[p->unit] - ex;
+        ex = m->unit_free[p->unit];
+    }
+    for(int k = 0; k < p->src_count; k++) {
+        long long ready = OperandReady(m, p->src[k], p->src_stage[k]);
+        if(ready > ex) {
+            line->raw += ready - ex;
+            m->total.raw += ready - ex;
+            ex = ready;
+        }
+    }
+    int cycles = p->unit == UNIT_MULT ? m->config.mult_latency :
+                 p->unit == UNIT_DIV ? m->config.div_latency : 1;
+    // written back after the older write (WB at ex + cycles + 1 at the earliest)
+    if(p->dest >= 0 && m->written[p->dest] - cycles > ex) {
+        long long wait = m->written[p->dest] - cycles - ex;
+        line->waw += wait;
+        m->total.waw += wait;
+        ex += wait;
+    }
+
+    // MEM and WB; the unit is held until MEM takes the instruction
+    long long mem = ReserveMem(m, ex + cycles);
+    long long wb = mem + 1;
+    m->unit_free[p->unit] = mem;
+    if(p->dest >= 0) {
+        m->ready[p->dest] = p->is_load ? mem + 1 : ex + cycles;
+        m->written[p->dest] = wb;
+    }
+    if(wb > m->last_wb)
+        m->last_wb = wb;
+
+    long long issue = m->started ? ex - m->prev_ex : ex - 1;
+    line->instructions++;
+    line->cycles += issue;
+    m->total.instructions++;
+    m->total.cycles += issue;
+
+    m->started = 1;
+    m->prev_index = index;
+    m->prev_if = if_cycle;
+    m->prev_id = id_cycle;
+    m->prev_ex = ex;
+}
+
+void PipelineTotals(const PipelineModel *model, PipelineCounts *total) {
+    *total = model->total;
+    // cycles run from the first fetch (cycle 0) to the last write-back
+    total->cycles = model->total.instructions ? model->last_wb + 1 : 0;
+}
+
+int PipelineLineCount(const PipelineModel *model) {
+    return model->line_count;
+}
+
+const PipelineCounts *PipelineLine(const PipelineModel *model, int line) {
+    return &model->by_line[line];
+}
+
+static double Cpi(long long cycles, long long instructions) {
+    return instructions ? (double)cycles / instructions : 0.0;
+}
+
+void PrintPipelineReport(const PipelineModel *model, FILE *out) {
+    PipelineCounts total;
+    PipelineTotals(model, &total);
+    fprintf(out, "Pipeline: %lld cycles, %lld instructions, CPI %.2f (forwarding %s, dmult %d, ddiv %d cycles)\n",
+            total.cycles, total.instructions, Cpi(total.cycles, total.instructions),
+            model->config.forwarding ? "on" : "off", model->config.mult_latency, model->config.div_latency);
+    fprintf(out, "Stalls: %lld RAW, %lld WAW, %lld structural, %lld taken branch\n",
+            total.raw, total.waw, total.structural, total.branch);
+    fprintf(out, "  line  instrs  cycles   CPI    RAW    WAW  struct  branch\n");
+    for(int i = 0; i < model->line_count; i++) {
+        const PipelineCounts *c = &model->by_line[i];
+        if(!c->instructions)
+            continue;
+        if(i == 0)
+            fprintf(out, "  (end)");
+        else
+            fprintf(out, "  %4d", i);
+        fprintf(out, " %7lld %7lld %5.2f %6lld %6lld %7lld %7lld\n", c->instructions, c->cycles,
+                Cpi(c->cycles, c->instructions), c->raw, c->waw, c->structural, c->branch);
+    }
+}
+
+void PrintPipelineCsvHeader(FILE *out) {
+    fprintf(out, "file,line,instructions,cycles,cpi,raw,waw,structural,branch\n");
+}
+
+static void CsvRow(FILE *out, const char *name, const char *line, const PipelineCounts *c) {
+    fprintf(out, "%s,%s,%lld,%lld,%.4f,%lld,%lld,%lld,%lld\n", name, line, c->instructions, c->cycles,
+            Cpi(c->cycles, c->instructions), c->raw, c->waw, c->structural, c->branch);
+}
+
+void PrintPipelineCsv(const PipelineModel *model, const char *name, FILE *out) {
+    char line[16];
+    for(int i = 0; i < model->line_count; i++) {
+        if(!model->by_line[i].instructions)
+            continue;
+        snprintf(line, sizeof(line), "%d", i);
+        CsvRow(out, name, line, &model->by_line[i]);
+    }
+    PipelineCounts total;
+    PipelineTotals(model, &total);
+    CsvRow(out, name, "total", &total);
+}
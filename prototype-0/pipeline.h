@@ -0,0 +1,50 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include "object_file.h"
+
+// IF ID EX MEM WB timing of the executed instruction stream, EduMIPS64 style:
+// branches resolve in ID (a taken one squashes the instruction fetched behind it),
+// dmult and ddiv run in their own non-pipelined units and may finish out of order,
+// one instruction enters MEM per cycle
+typedef struct {
+    int forwarding;    // results bypass to EX (and to ID for branches); 0: read after WB
+    int mult_latency;  // EX cycles of dmult
+    int div_latency;   // EX cycles of ddiv
+} PipelineConfig;
+
+#define PIPELINE_MULT_LATENCY 4 // same latencies the scheduler plans with
+#define PIPELINE_DIV_LATENCY 8
+#define PIPELINE_MAX_LATENCY 64
+
+typedef struct {
+    long long instructions;
+    long long cycles;      // cycles between entering EX and the previous instruction entering it
+    long long raw;         // waiting for an operand
+    long long waw;         // waiting so a result is not written before an older one
+    long long structural;  // EX unit or MEM busy
+    long long branch;      // taken branches and jumps
+} PipelineCounts;
+
+typedef struct PipelineModel PipelineModel;
+
+void PipelineDefaultConfig(PipelineConfig *config);
+PipelineModel *PipelineCreate(const PipelineConfig *config, const ObjectImage *image);
+void PipelineFree(PipelineModel *model);
+
+// SimTrace callback: pass the model as the trace context of Simulate
+void PipelineStep(void *model, int index);
+
+// totals (cycles include filling and draining the pipeline) and per source line counts;
+// line 0 collects instructions without a source line
+void PipelineTotals(const PipelineModel *model, PipelineCounts *total);
+int PipelineLineCount(const PipelineModel *model);
+const PipelineCounts *PipelineLine(const PipelineModel *model, int line);
+
+void PrintPipelineReport(const PipelineModel *model, FILE *out);
+// one row per source line and a "total" row
+void PrintPipelineCsvHeader(FILE *out);
+void PrintPipelineCsv(const PipelineModel *model, const char *name, FILE *out);
+
+#endif
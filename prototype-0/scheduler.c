@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+// cycles from issuing an instruction until a dependent one can issue without
+// stalling, on EduMIPS64's in-order 5-stage pipeline with forwarding
+#define LATENCY_ALU 1
+#define LATENCY_LOAD 2  // value leaves MEM one cycle after an ALU result
+#define LATENCY_MULT 4  // dmult -> mflo/mfhi
+#define LATENCY_DIV 8   // ddiv -> mflo/mfhi
+
+// HI/LO tracked as one extra register
+#define REG_HILO 32
+#define REG_COUNT 33
+
+// instructions are scheduled in windows of at most this many
+#define REGION_MAX 128
+
+// registers written, with the latency of each result
+static int Writes(const Instruction *ins, int regs[2], int latency[2]) {
+    switch(ins->op) {
+        case INS_DMULT:
+            regs[0] = REG_HILO;
+            latency[0] = LATENCY_MULT;
+            return 1;
+        case INS_DDIV:
+            regs[0] = REG_HILO;
+            latency[0] = LATENCY_DIV;
+            return 1;
+        default: {
+            int rd = InstructionDef(ins);
+            if(rd <= 0)
+                return 0; // nothing, or r0
+            regs[0] = rd;
+            latency[0] = ins->op == INS_LD ? LATENCY_LOAD : LATENCY_ALU;
+            return 1;
+        }
+    }
+}
+
+static int Reads(const Instruction *ins, int regs[4]) {
+    int n = InstructionUses(ins, regs);
+    if(ins->op == INS_MFLO || ins->op == INS_MFHI)
+        regs[n++] = REG_HILO;
+    return n;
+}
+
+// memory touched: 0 none, 1 reads, 2 writes; *symbol is NULL when any address may be involved
+static int MemoryAccess(const Instruction *ins, const char **symbol) {
+    *symbol = (ins->symbol && ins->rs == 0) ? ins->symbol : NULL;
+    switch(ins->op) {
+        case INS_LD:
+            return 1;
+        case INS_SD:
+            return 2;
+        case INS_SYSCALL:
+            // syscalls 1 and 11 only look at r4; the rest read strings or the printf block
+            *symbol = NULL;
+            return (ins->imm == 1 || ins->imm == 11) ? 0 : 1;
+        default:
+            return 0;
+    }
+}
+
+// registers and memory an instruction touches, worked out once per region
+typedef struct {
+    int writes[2], write_latency[2], reads[4];
+    int write_count, read_count;
+    int mem;              // MemoryAccess
+    const char *symbol;
+} Access;
+
+static void Summarize(const Instruction *ins, Access *acc) {
+    acc->write_count = Writes(ins, acc->writes, acc->write_latency);
+    acc->read_count = Reads(ins, acc->reads);
+    acc->mem = MemoryAccess(ins, &acc->symbol);
+}
+
+// latency of the edge that keeps b after a (a before b in program order), 0 if independent
+static int Dependence(const Instruction *a, const Access *pa, const Instruction *b, const Access *pb) {
+    int latency = 0;
+
+    // RAW
+    for(int i = 0; i < pa->write_count; i++) {
+        for(int j = 0; j < pb->read_count; j++) {
+            if(pa->writes[i] == pb->reads[j] && pa->write_latency[i] > latency)
+                latency = pa->write_latency[i];
+        }
+    }
+    // WAR and WAW only have to keep their order
+    for(int i = 0; i < pb->write_count && !latency; i++) {
+        for(int j = 0; j < pa->read_count; j++) {
+            if(pb->writes[i] == pa->reads[j])
+                latency = 1;
+        }
+        for(int j = 0; j < pa->write_count; j++) {
+            if(pb->writes[i] == pa->writes[j])
+                latency = 1;
+        }
+    }
+
+    // memory: at least one side writes and the addresses may be the same
+    if(!latency && pa->mem && pb->mem && (pa->mem == 2 || pb->mem == 2)) {
+        if(!pa->symbol || !pb->symbol || strcmp(pa->symbol, pb->symbol) == 0)
+            latency = 1;
+    }
+
+    // output order, and nothing moves past exit
+    if(!latency && b->op == INS_SYSCALL && (a->op == INS_SYSCALL || b->imm == 10))
+        latency = 1;
+
+    return latency;
+}
+
+int CountStalls(const InstructionList *code) {
+    int ready[REG_COUNT] = { 0 };
+    int cycle = -1;
+    int stalls = 0;
+
+    for(int i = 0; i < code->count; i++) {
+        const Instruction *ins = &code->items[i];
+        int reads[4], writes[2], latency[2];
+        int issue = cycle + 1;
+
+        int nr = Reads(ins, reads);
+        for(int k = 0; k < nr; k++) {
+            if(ready[reads[k]] > issue)
+                issue = ready[reads[k]];
+        }
+        stalls += issue - (cycle + 1);
+        cycle = issue;
+
+        int nw = Writes(ins, writes, latency);
+        for(int k = 0; k < nw; k++) {
+            ready[writes[k]] = issue + latency[k];
+        }
+    }
+    return stalls;
+}
+
+// reorder items[0 .. count-1] in place
+static void ScheduleRegion(Instruction *items, int count) {
+    static unsigned char edge[REGION_MAX][REGION_MAX]; // latency from i to j, 0 if none
+    int preds[REGION_MAX], earliest[REGION_MAX], priority[REGION_MAX], done[REGION_MAX];
+    Instruction ordered[REGION_MAX];
+    Access access[REGION_MAX];
+
+    for(int i = 0; i < count; i++) {
+        Summarize(&items[i], &access[i]);
+        preds[i] = 0;
+        earliest[i] = 0;
+        done[i] = 0;
+        for(int j = 0; j < count; j++) {
+            edge[i][j] = 0;
+        }
+    }
+    for(int j = 0; j < count; j++) {
+        for(int i = 0; i < j; i++) {
+            edge[i][j] = Dependence(&items[i], &access[i], &items[j], &access[j]);
+            if(edge[i][j])
+                preds[j]++;
+        }
+    }
+
+    // priority: longest latency path to the end of the region
+    for(int i = count - 1; i >= 0; i--) {
+        priority[i] = 1;
+        for(int j = i + 1; j < count; j++) {
+            if(edge[i][j] && edge[i][j] + priority[j] > priority[i])
+                priority[i] = edge[i][j] + priority[j];
+        }
+    }
+
+    // each cycle issue the ready instruction that can start soonest,
+    // preferring the longest remaining path, then program order
+    int cycle = -1;
+    for(int n = 0; n < count; n++) {
+        int best = -1, best_start = 0;
+        for(int i = 0; i < count; i++) {
+            if(done[i] || preds[i])
+                continue;
+            int start = earliest[i] > cycle + 1 ? earliest[i] : cycle + 1;
+            if(best == -1 || start < best_start ||
+               (start == best_start && priority[i] > priority[best])) {
+                best = i;
+                best_start = start;
+            }
+        }
+
+        done[best] = 1;
+        cycle = best_start;
+        ordered[n] = items[best];
+        for(int j = best + 1; j < count; j++) {
+            if(!edge[best][j])
+                continue;
+            preds[j]--;
+            if(cycle + edge[best][j] > earliest[j])
+                earliest[j] = cycle + edge[best][j];
+        }
+    }
+
+    memcpy(items, ordered, sizeof(Instruction) * count);
+}
+
+void ScheduleInstructions(InstructionList *code, ScheduleStats *stats) {
+    if(stats) {
+        stats->instructions = code->count;
+        stats->stalls_before = CountStalls(code);
+    }
+
+    // windows end at exit and after REGION_MAX instructions
+    int start = 0;
+    while(start < code->count) {
+        int end = start;
+        while(end < code->count && end - start < REGION_MAX) {
+            const Instruction *ins = &code->items[end++];
+            if(ins->op == INS_SYSCALL && ins->imm == 10)
+                break;
+        }
+        ScheduleRegion(code->items + start, end - start);
+        start = end;
+    }
+
+    if(stats)
+        stats->stalls_after = CountStalls(code);
+}
+
+void PrintScheduleStats(const ScheduleStats *stats, FILE *out) {
+    fprintf(out, "Pipeline stalls: %d before scheduling, %d after (%d instructions)\n",
+            stats->stalls_before, stats->stalls_after, stats->instructions);
+}
@@ -0,0 +1,22 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include "instruction.h"
+
+// pipeline stalls predicted for the .code stream before and after scheduling
+typedef struct {
+    int instructions;
+    int stalls_before;
+    int stalls_after;
+} ScheduleStats;
+
+// stall cycles of the in-order 5-stage pipeline (with forwarding) for the list as it stands
+int CountStalls(const InstructionList *code);
+
+// list scheduling of independent instructions to hide load-use and multiply latency;
+// stats may be NULL
+void ScheduleInstructions(InstructionList *code, ScheduleStats *stats);
+void PrintScheduleStats(const ScheduleStats *stats, FILE *out);
+
+#endif
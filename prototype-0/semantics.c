@@ -1,4 +1,5 @@
 #include "semantics.h"
+#include "arith.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -190,7 +191,7 @@ bool is_constant_expression(Node *expr) {
 }
 
 // evaluate constant numeric expression
-int eval_constant_expression(Node *expr) {
+long long eval_constant_expression(Node *expr) {
     if(!expr)
         return 0;
     
@@ -198,13 +199,13 @@ int eval_constant_expression(Node *expr) {
         case 0:  // NUM
             return expr->int_val;
         case 3:{  // BINOP
-            int left = eval_constant_expression(expr->binop.left);
-            int right = eval_constant_expression(expr->binop.right);
+            long long left = eval_constant_expression(expr->binop.left);
+            long long right = eval_constant_expression(expr->binop.right);
             switch(expr->binop.op) {
-                case '+': return left + right;
-                case '-': return left - right;
-                case '*': return left * right;
-                case '/': return right != 0 ? left / right : 0;
+                case '+': return arith_add(left, right);
+                case '-': return arith_sub(left, right);
+                case '*': return arith_mul(left, right);
+                case '/': return arith_div(left, right);
                 default: return 0;
             }
         }
@@ -66,7 +66,7 @@ bool is_string_expression(Node *expr);
 bool is_constant_expression(Node *expr);
 
 // evaluate constant numeric expression
-int eval_constant_expression(Node *expr);
+long long eval_constant_expression(Node *expr);
 
 // NEW: Check if expression in print statement is valid (no string vars in arithmetic)
 bool sem_check_print_expression(Semantics *sem, Node *expr);
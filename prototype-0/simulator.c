@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simulator.h"
+#include "machine_code.h"
+
+// gcc/clang: jump straight from one handler to the next (labels as values);
+// anything else (or -DSIM_NO_THREADING) gets the same handlers as a switch
+#if defined(__GNUC__) && !defined(SIM_NO_THREADING)
+#define SIM_THREADED 1
+#endif
+
+typedef enum {
+    SIM_OP_INVALID = 0,
+    SIM_OP_DADDIU,
+    SIM_OP_DADDU,
+    SIM_OP_DSUBU,
+    SIM_OP_SLTU,
+    SIM_OP_DMULT,
+    SIM_OP_DDIV,
+    SIM_OP_MFLO,
+    SIM_OP_MFHI,
+    SIM_OP_LD,
+    SIM_OP_SD,
+    SIM_OP_BEQ,
+    SIM_OP_BNE,
+    SIM_OP_J,
+    SIM_OP_SYSCALL,
+    SIM_OP_LUI,
+    SIM_OP_ORI,
+    SIM_OP_DSLL,
+    SIM_OP_END,      // one past the last instruction
+    SIM_OP_COUNT
+} SimOp;
+
+// one instruction decoded once, ahead of execution
+typedef struct {
+    const void *handler; // threaded dispatch target
+    int64_t imm;         // sign-extended immediate (zero-extended for ori, shifted for lui),
+                         // shift amount, branch/jump target index, syscall code
+    uint8_t op;
+    uint8_t rd, rs, rt;  // a destination of r0 is redirected to the sink register
+} Decoded;
+
+// r0 reads as 0; writes to it land here
+#define REG_SINK 32
+
+static uint8_t Dest(uint32_t reg) {
+    return reg == 0 ? REG_SINK : (uint8_t)reg;
+}
+
+// code[0 .. count] (the extra slot is SIM_OP_END)
+static void Decode(const uint32_t *words, int count, Decoded *code) {
+    for(int i = 0; i < count; i++) {
+        uint32_t w = words[i];
+        uint32_t rs = (w >> 21) & 31, rt = (w >> 16) & 31, rd = (w >> 11) & 31;
+        Decoded *d = &code[i];
+        memset(d, 0, sizeof(*d));
+        d->rs = rs;
+        d->rt = rt;
+        d->imm = (int16_t)(w & 0xFFFF);
+
+        switch(w >> 26) {
+            case 0:
+                switch(w & 0x3F) {
+                    case FUNCT_DADDU: d->op = SIM_OP_DADDU; d->rd = Dest(rd); break;
+                    case FUNCT_DSUBU: d->op = SIM_OP_DSUBU; d->rd = Dest(rd); break;
+                    case FUNCT_SLTU: d->op = SIM_OP_SLTU; d->rd = Dest(rd); break;
+                    case FUNCT_DMULT + 4: d->op = SIM_OP_DMULT; break;
+                    case FUNCT_DDIV + 4: d->op = SIM_OP_DDIV; break;
+                    case FUNCT_MFLO: d->op = SIM_OP_MFLO; d->rd = Dest(rd); break;
+                    case FUNCT_MFHI: d->op = SIM_OP_MFHI; d->rd = Dest(rd); break;
+                    case FUNCT_SYSCALL: d->op = SIM_OP_SYSCALL; d->imm = (w >> 6) & 0xFFFFF; break;
+                    case FUNCT_DSLL: d->op = SIM_OP_DSLL; d->rd = Dest(rd); d->imm = (w >> 6) & 31; break;
+                    default: d->op = SIM_OP_INVALID; break;
+                }
+                break;
+            case OP_DADDIU: d->op = SIM_OP_DADDIU; d->rt = Dest(rt); break;
+            case OP_LUI: d->op = SIM_OP_LUI; d->rt = Dest(rt); d->imm *= 0x10000; break;
+            case OP_ORI: d->op = SIM_OP_ORI; d->rt = Dest(rt); d->imm = w & 0xFFFF; break;
+            case OP_LD: d->op = SIM_OP_LD; d->rt = Dest(rt); break;
+            case OP_SD: d->op = SIM_OP_SD; break;
+            case OP_BEQ:
+            case OP_BNE:
+                d->op = (w >> 26) == OP_BEQ ? SIM_OP_BEQ : SIM_OP_BNE;
+                d->imm = i + 1 + d->imm;
+                if(d->imm < 0 || d->imm > count)
+                    d->op = SIM_OP_INVALID;
+                break;
+            case OP_J:
+                d->op = SIM_OP_J;
+                d->imm = w & 0x3FFFFFF;
+                if(d->imm > count)
+                    d->op = SIM_OP_INVALID;
+                break;
+            default:
+                d->op = SIM_OP_INVALID;
+                break;
+        }
+    }
+    memset(&code[count], 0, sizeof(Decoded));
+    code[count].op = SIM_OP_END;
+}
+
+// MEMORY
+
+typedef struct {
+    uint8_t *bytes;
+    uint64_t size;
+} Memory;
+
+// doubleword at addr, 8-byte aligned and inside memory; 0 if it is not
+static int CheckDoubleword(const Memory *m, uint64_t addr) {
+    return (addr & 7) == 0 && addr < m->size && m->size - addr >= 8;
+}
+
+static uint64_t LoadBigEndian(const uint8_t *p) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return __builtin_bswap64(v);
+#else
+    uint64_t v = 0;
+    for(int i = 0; i < 8; i++)
+        v = v << 8 | p[i];
+    return v;
+#endif
+}
+
+static void StoreBigEndian(uint8_t *p, uint64_t v) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+    memcpy(p, &v, 8);
+#else
+    for(int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+#endif
+}
+
+// SYSCALLS
+
+// NUL-terminated string at addr; 0 if it runs out of memory
+static int PutMemoryString(AsmBuffer *out, const Memory *m, uint64_t addr) {
+    if(addr >= m->size)
+        return 0;
+    const uint8_t *start = m->bytes + addr;
+    const uint8_t *nul = memchr(start, 0, m->size - addr);
+    if(!nul)
+        return 0;
+    size_t length = nul - start;
+    char *p = AsmReserve(out, length);
+    memcpy(p, start, length);
+    AsmCommit(out, p + length);
+    return 1;
+}
+
+static void PutInt(AsmBuffer *out, uint64_t value) {
+    AsmCommit(out, FormatInt(AsmReserve(out, 21), (long long)value));
+}
+
+// syscall 5: r14 points at the block; word 0 is the format address, then the arguments
+// (%d integer, %s string address, %% percent sign)
+static int Printf(AsmBuffer *out, const Memory *m, uint64_t block) {
+    if(!CheckDoubleword(m, block))
+        return 0;
+    uint64_t format = LoadBigEndian(m->bytes + block);
+    if(format >= m->size || !memchr(m->bytes + format, 0, m->size - format))
+        return 0;
+
+    const char *f = (const char *)m->bytes + format;
+    uint64_t arg = block + 8;
+    while(*f) {
+        const char *percent = strchr(f, '%');
+        size_t literal = percent ? (size_t)(percent - f) : strlen(f);
+        char *p = AsmReserve(out, literal);
+        memcpy(p, f, literal);
+        AsmCommit(out, p + literal);
+        f += literal;
+        if(!*f)
+            break;
+
+        char conversion = f[1];
+        f += conversion ? 2 : 1;
+        if(conversion == '%') {
+            AsmPutString(out, "%");
+            continue;
+        }
+        if(!CheckDoubleword(m, arg))
+            return 0;
+        uint64_t value = LoadBigEndian(m->bytes + arg);
+        arg += 8;
+        if(conversion == 'd')
+            PutInt(out, value);
+        else if(conversion == 's') {
+            if(!PutMemoryString(out, m, value))
+                return 0;
+        } else
+            return 0;
+    }
+    return 1;
+}
+
+// EXECUTION
+
+SimStatus Simulate(const ObjectImage *image, AsmBuffer *out, const SimOptions *options, SimResult *result) {
+    long long max_instructions = options ? options->max_instructions : 0;
+    SimTrace trace = options ? options->trace : NULL;
+    void *trace_context = options ? options->trace_context : NULL;
+
+    Decoded *code = malloc(sizeof(Decoded) * (image->code_count + 1));
+    Decode(image->code, image->code_count, code);
+
+    Memory memory;
+    memory.size = image->data_size;
+    memory.bytes = malloc(memory.size ? memory.size : 1);
+    if(memory.size)
+        memcpy(memory.bytes, image->data, memory.size);
+
+    uint64_t r[33] = { 0 };
+    uint64_t hi = 0, lo = 0;
+    long long executed = 0;
+    const Decoded *pc = code;
+    const Decoded *ins;
+    const char *fault = NULL;
+    SimStatus status = SIM_EXIT;
+
+#ifdef SIM_THREADED
+    static const void *handlers[SIM_OP_COUNT] = {
+        [SIM_OP_INVALID] = &&op_invalid,
+        [SIM_OP_DADDIU] = &&op_daddiu,
+        [SIM_OP_DADDU] = &&op_daddu,
+        [SIM_OP_DSUBU] = &&op_dsubu,
+        [SIM_OP_SLTU] = &&op_sltu,
+        [SIM_OP_DMULT] = &&op_dmult,
+        [SIM_OP_DDIV] = &&op_ddiv,
+        [SIM_OP_MFLO] = &&op_mflo,
+        [SIM_OP_MFHI] = &&op_mfhi,
+        [SIM_OP_LD] = &&op_ld,
+        [SIM_OP_SD] = &&op_sd,
+        [SIM_OP_BEQ] = &&op_beq,
+        [SIM_OP_BNE] = &&op_bne,
+        [SIM_OP_J] = &&op_j,
+        [SIM_OP_SYSCALL] = &&op_syscall,
+        [SIM_OP_LUI] = &&op_lui,
+        [SIM_OP_ORI] = &&op_ori,
+        [SIM_OP_DSLL] = &&op_dsll,
+        [SIM_OP_END] = &&op_end,
+    };
+    // tracing sends every real instruction through op_trace first
+    for(int i = 0; i <= image->code_count; i++) {
+        int traced = trace && code[i].op != SIM_OP_END && code[i].op != SIM_OP_INVALID;
+        code[i].handler = traced ? &&op_trace : handlers[code[i].op];
+    }
+#define HANDLER(name, op) name:
+#define NEXT() do { ins = pc++; executed++; goto *ins->handler; } while(0)
+    NEXT();
+#else
+#define HANDLER(name, op) case op:
+#define NEXT() goto dispatch
+dispatch:
+    ins = pc++;
+    executed++;
+    if(trace && ins->op != SIM_OP_END && ins->op != SIM_OP_INVALID)
+        trace(trace_context, (int)(ins - code));
+    switch(ins->op) {
+#endif
+// taken branches are where an endless loop would be caught
+#define TAKE_BRANCH() do { \
+        if(max_instructions && executed >= max_instructions) { \
+            status = SIM_LIMIT; \
+            goto done; \
+        } \
+        pc = code + ins->imm; \
+        NEXT(); \
+    } while(0)
+
+    HANDLER(op_daddiu, SIM_OP_DADDIU)
+        r[ins->rt] = r[ins->rs] + (uint64_t)ins->imm;
+        NEXT();
+    HANDLER(op_daddu, SIM_OP_DADDU)
+        r[ins->rd] = r[ins->rs] + r[ins->rt];
+        NEXT();
+    HANDLER(op_dsubu, SIM_OP_DSUBU)
+        r[ins->rd] = r[ins->rs] - r[ins->rt];
+        NEXT();
+    HANDLER(op_sltu, SIM_OP_SLTU)
+        r[ins->rd] = r[ins->rs] < r[ins->rt];
+        NEXT();
+    HANDLER(op_dmult, SIM_OP_DMULT) {
+        // only LO is read back by the code generator; HI is the signed high half
+#if defined(__SIZEOF_INT128__)
+        __int128 product = (__int128)(int64_t)r[ins->rs] * (int64_t)r[ins->rt];
+        lo = (uint64_t)product;
+        hi = (uint64_t)(product >> 64);
+#else
+        lo = r[ins->rs] * r[ins->rt];
+        hi = 0;
+#endif
+        NEXT();
+    }
+    HANDLER(op_ddiv, SIM_OP_DDIV) {
+        int64_t a = (int64_t)r[ins->rs], b = (int64_t)r[ins->rt];
+        if(b == 0) {
+            // the generated code guards its divisions; an unguarded one is a bug to report
+            fault = "ddiv by zero";
+            goto fail;
+        } else if(a == INT64_MIN && b == -1) {
+            lo = (uint64_t)a;
+            hi = 0;
+        } else {
+            lo = (uint64_t)(a / b);
+            hi = (uint64_t)(a % b);
+        }
+        NEXT();
+    }
+    HANDLER(op_lui, SIM_OP_LUI)
+        r[ins->rt] = (uint64_t)ins->imm;
+        NEXT();
+    HANDLER(op_ori, SIM_OP_ORI)
+        r[ins->rt] = r[ins->rs] | (uint64_t)ins->imm;
+        NEXT();
+    HANDLER(op_dsll, SIM_OP_DSLL)
+        r[ins->rd] = r[ins->rt] << ins->imm;
+        NEXT();
+    HANDLER(op_mflo, SIM_OP_MFLO)
+        r[ins->rd] = lo;
+        NEXT();
+    HANDLER(op_mfhi, SIM_OP_MFHI)
+        r[ins->rd] = hi;
+        NEXT();
+    HANDLER(op_ld, SIM_OP_LD) {
+        uint64_t addr = r[ins->rs] + (uint64_t)ins->imm;
+        if(!CheckDoubleword(&memory, addr)) {
+            fault = "ld from an address outside .data or not 8-byte aligned";
+            goto fail;
+        }
+        r[ins->rt] = LoadBigEndian(memory.bytes + addr);
+        NEXT();
+    }
+    HANDLER(op_sd, SIM_OP_SD) {
+        uint64_t addr = r[ins->rs] + (uint64_t)ins->imm;
+        if(!CheckDoubleword(&memory, addr)) {
+            fault = "sd to an address outside .data or not 8-byte aligned";
+            goto fail;
+        }
+        StoreBigEndian(memory.bytes + addr, r[ins->rt]);
+        NEXT();
+    }
+    HANDLER(op_beq, SIM_OP_BEQ)
+        if(r[ins->rs] == r[ins->rt])
+            TAKE_BRANCH();
+        NEXT();
+    HANDLER(op_bne, SIM_OP_BNE)
+        if(r[ins->rs] != r[ins->rt])
+            TAKE_BRANCH();
+        NEXT();
+    HANDLER(op_j, SIM_OP_J)
+        TAKE_BRANCH();
+    HANDLER(op_syscall, SIM_OP_SYSCALL)
+        switch(ins->imm) {
+            case 1:
+                PutInt(out, r[4]);
+                break;
+            case 4:
+                if(!PutMemoryString(out, &memory, r[4])) {
+                    fault = "syscall 4 string runs outside .data";
+                    goto fail;
+                }
+                break;
+            case 5:
+                if(!Printf(out, &memory, r[14])) {
+                    fault = "syscall 5 with a bad parameter block or format";
+                    goto fail;
+                }
+                break;
+            case 10:
+                goto done;
+            case 11: {
+                char *p = AsmReserve(out, 1);
+                *p = (char)r[4];
+                AsmCommit(out, p + 1);
+                break;
+            }
+            default:
+                fault = "unknown syscall";
+                goto fail;
+        }
+        NEXT();
+    HANDLER(op_end, SIM_OP_END)
+        executed--; // not an instruction
+        goto done;
+    HANDLER(op_invalid, SIM_OP_INVALID)
+        fault = "instruction cannot be decoded";
+        goto fail;
+#ifdef SIM_THREADED
+op_trace:
+    trace(trace_context, (int)(ins - code));
+    goto *handlers[ins->op];
+#endif
+
+#ifndef SIM_THREADED
+    }
+#endif
+#undef HANDLER
+#undef NEXT
+#undef TAKE_BRANCH
+
+fail:
+    status = SIM_FAULT;
+done:
+    if(result) {
+        result->status = status;
+        result->instructions = executed;
+        result->fault_pc = (int)(ins - code) * 4;
+        result->fault = fault;
+    }
+    free(code);
+    free(memory.bytes);
+    return status;
+}
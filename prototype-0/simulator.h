@@ -0,0 +1,39 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include "object_file.h"
+#include "asm_buffer.h"
+
+// how a simulation ended
+typedef enum {
+    SIM_EXIT = 0,     // syscall 10, or ran off the end of .code
+    SIM_FAULT,        // undecodable instruction, bad address or bad syscall
+    SIM_LIMIT         // max_instructions reached
+} SimStatus;
+
+typedef struct {
+    SimStatus status;
+    long long instructions; // executed, including the final syscall
+    int fault_pc;           // code address of the faulting instruction
+    const char *fault;      // what went wrong, NULL unless SIM_FAULT
+} SimResult;
+
+// called with the index (code address / 4) of every instruction before it executes
+typedef void (*SimTrace)(void *context, int index);
+
+typedef struct {
+    long long max_instructions; // 0 means no limit (checked on taken branches only:
+                                // straight-line code always ends)
+    SimTrace trace;             // NULL to run untraced at full speed
+    void *trace_context;
+} SimOptions;
+
+// run an assembled program on a MIPS64 model of the instructions the code generator and
+// the assembler produce (daddiu daddu dsubu sltu dmult ddiv mflo mfhi ld sd beq bne j syscall)
+// syscalls 1/4/11/5 print an integer, string, character or printf block to out; 10 exits
+// the code is decoded once into a cache, then run by a threaded (computed goto) loop
+// options may be NULL
+SimStatus Simulate(const ObjectImage *image, AsmBuffer *out, const SimOptions *options, SimResult *result);
+
+#endif
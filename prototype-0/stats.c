@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+// glibc lets a program replace malloc and friends; these count the calls and hand them on,
+// so everything that allocates (the lexer's strdup too) is seen. They replace the allocator
+// for the whole program, so only builds that ask for them get them (make STATS_MALLOC=1)
+#if defined(STATS_MALLOC_COUNT) && defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define STATS_COUNTS_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void __libc_free(void *pointer);
+
+static long long allocation_count;
+
+void *malloc(size_t size) {
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocation_count++;
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+    __libc_free(pointer);
+}
+#endif
+
+long long stats_allocations(void) {
+#ifdef STATS_COUNTS_ALLOCATIONS
+    return allocation_count;
+#else
+    return -1;
+#endif
+}
+
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes there, kilobytes on Linux
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+void stats_init(Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void stats_begin(Stats *stats, const char *name) {
+    if(!stats || stats->phase_count >= STATS_MAX_PHASES)
+        return;
+    StatsPhase *phase = &stats->phases[stats->phase_count];
+    phase->name = name;
+    stats->wall_start = wall_seconds();
+    stats->cpu_start = (double)clock() / CLOCKS_PER_SEC;
+    stats->allocations_start = stats_allocations();
+}
+
+void stats_end(Stats *stats) {
+    if(!stats || stats->phase_count >= STATS_MAX_PHASES)
+        return;
+    StatsPhase *phase = &stats->phases[stats->phase_count++];
+    phase->wall_seconds = wall_seconds() - stats->wall_start;
+    phase->cpu_seconds = (double)clock() / CLOCKS_PER_SEC - stats->cpu_start;
+    long long allocations = stats_allocations();
+    phase->allocations = allocations < 0 ? -1 : allocations - stats->allocations_start;
+    phase->peak_rss_kb = peak_rss_kb();
+}
+
+static void totals(const Stats *stats, StatsPhase *total) {
+    total->name = "total";
+    total->wall_seconds = 0;
+    total->cpu_seconds = 0;
+    total->allocations = stats_allocations() < 0 ? -1 : 0;
+    total->peak_rss_kb = peak_rss_kb();
+    for(int i = 0; i < stats->phase_count; i++) {
+        total->wall_seconds += stats->phases[i].wall_seconds;
+        total->cpu_seconds += stats->phases[i].cpu_seconds;
+        if(total->allocations >= 0)
+            total->allocations += stats->phases[i].allocations;
+    }
+}
+
+static void print_row(const StatsPhase *phase, FILE *out) {
+    fprintf(out, "  %-13s %10.3f %10.3f", phase->name, phase->wall_seconds * 1e3, phase->cpu_seconds * 1e3);
+    if(phase->allocations >= 0)
+        fprintf(out, " %12lld", phase->allocations);
+    else
+        fprintf(out, " %12s", "-");
+    if(phase->peak_rss_kb >= 0)
+        fprintf(out, " %12ld\n", phase->peak_rss_kb);
+    else
+        fprintf(out, " %12s\n", "-");
+}
+
+void stats_print(const Stats *stats, FILE *out) {
+    fprintf(out, "  %-13s %10s %10s %12s %12s\n", "phase", "wall ms", "cpu ms", "allocations", "peak RSS KB");
+    for(int i = 0; i < stats->phase_count; i++) {
+        print_row(&stats->phases[i], out);
+    }
+    StatsPhase total;
+    totals(stats, &total);
+    print_row(&total, out);
+    fprintf(out, "  %lld tokens, %lld AST nodes, %lld symbols, %lld instructions, %lld bytes of output\n",
+            stats->tokens, stats->nodes, stats->symbols, stats->instructions, stats->output_bytes);
+}
+
+// a count, or null when it is not known
+static void print_json_count(FILE *out, const char *key, long long value) {
+    if(value >= 0)
+        fprintf(out, "\"%s\": %lld", key, value);
+    else
+        fprintf(out, "\"%s\": null", key);
+}
+
+static void print_json_phase(const StatsPhase *phase, FILE *out) {
+    fprintf(out, "{\"name\": \"%s\", \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f, ", phase->name,
+            phase->wall_seconds, phase->cpu_seconds);
+    print_json_count(out, "allocations", phase->allocations);
+    fprintf(out, ", ");
+    print_json_count(out, "peak_rss_kb", phase->peak_rss_kb);
+    fprintf(out, "}");
+}
+
+void stats_print_json(const Stats *stats, FILE *out) {
+    fprintf(out, "{\n  \"phases\": [\n");
+    for(int i = 0; i < stats->phase_count; i++) {
+        fprintf(out, "    ");
+        print_json_phase(&stats->phases[i], out);
+        fprintf(out, i + 1 < stats->phase_count ? ",\n" : "\n");
+    }
+    StatsPhase total;
+    totals(stats, &total);
+    fprintf(out, "  ],\n  \"total\": ");
+    print_json_phase(&total, out);
+    fprintf(out, ",\n  \"counts\": {\"tokens\": %lld, \"nodes\": %lld, \"symbols\": %lld, "
+            "\"instructions\": %lld, \"output_bytes\": %lld}\n}\n",
+            stats->tokens, stats->nodes, stats->symbols, stats->instructions, stats->output_bytes);
+}
@@ -0,0 +1,45 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// -stats: wall and CPU time, allocations and peak resident memory of each compiler phase,
+// and the size of what the phases made
+#define STATS_MAX_PHASES 16
+
+typedef struct {
+    const char *name;
+    double wall_seconds;
+    double cpu_seconds;
+    long long allocations;  // malloc/calloc/realloc calls, -1 if this build cannot count them
+    long peak_rss_kb;       // high-water mark of resident memory when the phase ended, -1 if unknown
+} StatsPhase;
+
+typedef struct {
+    StatsPhase phases[STATS_MAX_PHASES];
+    int phase_count;
+    double wall_start;      // of the phase in progress
+    double cpu_start;
+    long long allocations_start;
+    long long tokens;       // handed to the parser
+    long long nodes;        // in the AST
+    long long symbols;      // variables declared
+    long long instructions; // machine code words
+    long long output_bytes; // printed by the program when it ran
+} Stats;
+
+void stats_init(Stats *stats);
+
+// measure from stats_begin to stats_end as phase name; both do nothing if stats is NULL
+void stats_begin(Stats *stats, const char *name);
+void stats_end(Stats *stats);
+
+// malloc/calloc/realloc calls so far, -1 if they are not counted (only in builds with
+// STATS_MALLOC_COUNT, on glibc, and not under a sanitizer, which has its own malloc)
+long long stats_allocations(void);
+
+// a table, or one JSON object for tools
+void stats_print(const Stats *stats, FILE *out);
+void stats_print_json(const Stats *stats, FILE *out);
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdio.h>         
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include "symbol_table.h"
@@ -6,49 +7,59 @@
 // symbol table entry
 typedef struct {
     char name[MAX_NAME_LEN];
-    int reg; // reg assigned (-1 for labels like str0, str1 that have no register)
+    int variable; // variable number, in declaration order (-1 for labels like str0, str1)
     uint64_t offset; // memory offset
     int is_string_var; // NEW: 1 if this is a string variable (ch type), 0 otherwise
     char *string_value; // Store string value for string variables
+    int placed; // offset set by the current data layout (see ResetDataLayout)
 } SymbolEntry;
 
-static SymbolEntry table[MAX_SYMBOLS];
+// grows as symbols are added; spill slots and printf words can outnumber the variables
+static SymbolEntry *table = NULL;
 static int symbol_count = 0;
-static int next_reg = REG_MIN;
+static int symbol_capacity = 0;
+static int variable_count = 0;
 static uint64_t next_offset = 0x0;
 
-// print .data section with .space directives for integers, .asciiz for strings
+// print .data section with a .space doubleword for every variable
+// (a ch variable holds the address of its current string)
 void PrintDataSection(FILE *out) {
     for(int i = 0; i < symbol_count; i++) {
-        if(table[i].reg != -1) {
-            // Only generate .space for INTEGER variables, NOT for string variables
-            if(!table[i].is_string_var) {
-                // Integer variables (int type) get .space
-                fprintf(out, "%s: .space 8\n", table[i].name);
-            }
-            // String variables will be generated separately with .asciiz
-        }
+        if(table[i].variable != -1)
+            fprintf(out, "%s: .space 8\n", table[i].name);
     }
 }
 
 // initialize/reset symbol table
 void SymbolInit() {
     symbol_count = 0;
-    next_reg = REG_MIN;
+    variable_count = 0;
     next_offset = 0x0;
-    for(int i = 0; i < MAX_SYMBOLS; i++) {
-        table[i].name[0] = '\0';
-        table[i].is_string_var = 0;
-        table[i].string_value = NULL;
+}
+
+// a new entry at the end of the table, named name, with no value and no offset yet
+static SymbolEntry *NewSymbol(const char *name, int variable) {
+    if(symbol_count >= symbol_capacity) {
+        symbol_capacity = symbol_capacity ? symbol_capacity * 2 : 64;
+        table = realloc(table, sizeof(SymbolEntry) * symbol_capacity);
     }
+    SymbolEntry *entry = &table[symbol_count++];
+    strncpy(entry->name, name, MAX_NAME_LEN - 1);
+    entry->name[MAX_NAME_LEN - 1] = '\0';
+    entry->variable = variable;
+    entry->offset = next_offset;
+    entry->is_string_var = 0;
+    entry->string_value = NULL;
+    entry->placed = 0;
+    return entry;
 }
 
-// get register assigned to symbol
+// get variable number of symbol
 // returns -1 if symbol is a label (like str0) or not found
-int GetRegisterOfTheSymbol(const char *name) {
+int GetVariableOfTheSymbol(const char *name) {
     for(int i = 0; i < symbol_count; i++) {
         if(strcmp(table[i].name, name) == 0) {
-            return table[i].reg;
+            return table[i].variable;
         }
     }
     return -1;
@@ -56,7 +67,7 @@ int GetRegisterOfTheSymbol(const char *name) {
 
 // check if symbol exists (variable or label)
 int SymbolExists(const char *name) {
-    return GetRegisterOfTheSymbol(name) != -1 || GetOffsetOfTheSymbol(name) != (uint64_t)-1;
+    return GetVariableOfTheSymbol(name) != -1 || GetOffsetOfTheSymbol(name) != (uint64_t)-1;
 }
 
 // NEW: Check if symbol is a string variable
@@ -94,72 +105,34 @@ void SetStringValueOfSymbol(const char *name, const char *value) {
     }
 }
 
-// allocate a reg for a new symbol (for integer variables)
-int AllocateRegisterForTheSymbol(const char *name) {
+// add a new integer variable; every variable lives in its own .data doubleword
+int AllocateVariable(const char *name) {
     // check if alr allocated
-    int existing = GetRegisterOfTheSymbol(name);
+    int existing = GetVariableOfTheSymbol(name);
     if(existing != -1) {
         return existing;
     }
     
-    // check limits
-    if(symbol_count >= MAX_SYMBOLS) {
-        return -1;
-    }
-    
-    // skip r1-r4 (r4 is for syscall args)
-    if(next_reg >= 1 && next_reg <= 4)
-        next_reg = 5;
-    
-    if(next_reg > REG_MAX)
-        return -1;
-    
     // add symbol to table
-    strncpy(table[symbol_count].name, name, MAX_NAME_LEN - 1);
-    table[symbol_count].name[MAX_NAME_LEN - 1] = '\0';
-    table[symbol_count].reg = next_reg;
-    table[symbol_count].offset = next_offset;
-    table[symbol_count].is_string_var = 0; // Integer variable
-    table[symbol_count].string_value = NULL;
-    
-    symbol_count++;
+    NewSymbol(name, variable_count);
     next_offset += 8;  // 8 bytes for integer
     
-    return next_reg++;
+    return variable_count++;
 }
 
-// Allocate register for a string variable
+// add a new string variable
 int AllocateStringVariable(const char *name) {
     // check if alr allocated
-    int existing = GetRegisterOfTheSymbol(name);
+    int existing = GetVariableOfTheSymbol(name);
     if(existing != -1) {
         return existing;
     }
     
-    // check limits
-    if(symbol_count >= MAX_SYMBOLS) {
-        return -1;
-    }
-    
-    // skip r1-r4 (r4 is for syscall args)
-    if(next_reg >= 1 && next_reg <= 4)
-        next_reg = 5;
-    
-    if(next_reg > REG_MAX)
-        return -1;
-    
     // add symbol to table as string variable
-    strncpy(table[symbol_count].name, name, MAX_NAME_LEN - 1);
-    table[symbol_count].name[MAX_NAME_LEN - 1] = '\0';
-    table[symbol_count].reg = next_reg;
-    table[symbol_count].offset = next_offset;
-    table[symbol_count].is_string_var = 1; // Mark as string variable
-    table[symbol_count].string_value = NULL; // Initialize with no value
+    NewSymbol(name, variable_count)->is_string_var = 1;
+    next_offset += 8;  // address of the string
     
-    symbol_count++;
-    next_offset += 64;  // Allocate space for string
-    
-    return next_reg++;
+    return variable_count++;
 }
 
 // add label (for standalone strings) w/o register
@@ -171,18 +144,7 @@ void AddLabel(const char *name, uint64_t size) {
         }
     }
     
-    if(symbol_count >= MAX_SYMBOLS) {
-        return;
-    }
-    
-    strncpy(table[symbol_count].name, name, MAX_NAME_LEN - 1);
-    table[symbol_count].name[MAX_NAME_LEN - 1] = '\0';
-    table[symbol_count].reg = -1;           // marks this as a label, not a variable
-    table[symbol_count].offset = next_offset;
-    table[symbol_count].is_string_var = 0;
-    table[symbol_count].string_value = NULL;
-    
-    symbol_count++;
+    NewSymbol(name, -1); // -1 marks this as a label, not a variable
     next_offset += size;  // advance offset by string size (including '\0')
 }
 
@@ -196,16 +158,63 @@ uint64_t GetOffsetOfTheSymbol(const char *name) {
     return (uint64_t)-1; // not found
 }
 
+// total bytes of memory given out so far
+uint64_t GetDataSize() {
+    return next_offset;
+}
+
+// lay memory out again, in the order the .data section is written
+void ResetDataLayout() {
+    for(int i = 0; i < symbol_count; i++) {
+        table[i].placed = 0;
+    }
+    next_offset = 0x0;
+}
+
+// next item starts on a doubleword boundary, like every .data item in EduMIPS64
+uint64_t PlaceSymbol(const char *name, uint64_t size) {
+    for(int i = 0; i < symbol_count; i++) {
+        if(strcmp(table[i].name, name) == 0) {
+            if(table[i].placed)
+                return table[i].offset; // first definition wins
+            next_offset = (next_offset + 7) & ~(uint64_t)7;
+            table[i].offset = next_offset;
+            table[i].placed = 1;
+            next_offset += size;
+            return table[i].offset;
+        }
+    }
+    return (uint64_t)-1;
+}
+
+// variables, in PrintDataSection order
+void PlaceVariables() {
+    for(int i = 0; i < symbol_count; i++) {
+        if(table[i].variable != -1)
+            PlaceSymbol(table[i].name, 8);
+    }
+}
+
+// symbols the .data section does not write still get room after everything else
+uint64_t FinishDataLayout() {
+    for(int i = 0; i < symbol_count; i++) {
+        if(!table[i].placed)
+            PlaceSymbol(table[i].name, 8);
+    }
+    next_offset = (next_offset + 7) & ~(uint64_t)7;
+    return next_offset;
+}
+
 // print symbol table for debugging
 void PrintAllSymbols(FILE *out) {
     fprintf(out, "; Symbol Table\n");
-    fprintf(out, "; Name\t\tReg\tOffset\tType\t\tValue\n");
+    fprintf(out, "; Name\t\tVar\tOffset\tType\t\tValue\n");
     fprintf(out, "; ──────────────────────────────────────────────────────────────\n");
     for(int i = 0; i < symbol_count; i++) {
-        if(table[i].reg != -1) {
-            fprintf(out, "; %s\t\tr%d\t0x%lX\t%s\t",
+        if(table[i].variable != -1) {
+            fprintf(out, "; %s\t\t%d\t0x%lX\t%s\t",
                     table[i].name,
-                    table[i].reg,
+                    table[i].variable,
                     (unsigned long)table[i].offset,
                     table[i].is_string_var ? "STRING" : "INT");
             if(table[i].is_string_var && table[i].string_value) {
@@ -234,5 +243,8 @@ void SymbolCleanup() {
             free(table[i].string_value);
         }
     }
+    free(table);
+    table = NULL;
+    symbol_capacity = 0;
     SymbolInit();
 }
\ No newline at end of file
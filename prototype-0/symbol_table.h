@@ -4,10 +4,7 @@
 #include <stdio.h>
 #include <stdint.h>
 
-#define MAX_SYMBOLS 100
 #define MAX_NAME_LEN 50
-#define REG_MIN 1
-#define REG_MAX 31
 
 // Initialize symbol table
 void SymbolInit();
@@ -15,17 +12,17 @@ void SymbolInit();
 // Print data section (only integer variables)
 void PrintDataSection(FILE *out);
 
-// Allocate register for symbol (integer variables)
-int AllocateRegisterForTheSymbol(const char *name);
+// Add integer variable; returns its variable number
+int AllocateVariable(const char *name);
 
-// Allocate register for string variable
+// Add string variable; returns its variable number
 int AllocateStringVariable(const char *name);
 
 // Check if symbol exists
 int SymbolExists(const char *name);
 
-// Get register of symbol
-int GetRegisterOfTheSymbol(const char *name);
+// Get variable number of symbol (-1 for labels and unknown names)
+int GetVariableOfTheSymbol(const char *name);
 
 // Check if symbol is string variable
 int IsStringVariable(const char *name);
@@ -42,6 +39,17 @@ void AddLabel(const char *name, uint64_t size);
 // Get offset of symbol
 uint64_t GetOffsetOfTheSymbol(const char *name);
 
+// Lay memory out again in the order the .data section is written: ResetDataLayout,
+// then PlaceVariables/PlaceSymbol for each item (8-byte aligned), then FinishDataLayout
+// (places anything left over, returns the size)
+void ResetDataLayout();
+uint64_t PlaceSymbol(const char *name, uint64_t size);
+void PlaceVariables();
+uint64_t FinishDataLayout();
+
+// Total bytes of memory given out so far
+uint64_t GetDataSize();
+
 // Print all symbols (for debugging)
 void PrintAllSymbols(FILE *out);
 